@@ -60,10 +60,26 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef CACHESTAT
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
+#include "kma_magazine.h"
+#include "kma_heap.h"
+#include "kma_handle.h"
+#include "kma_large.h"
+#include "kma_file.h"
+#include "kma_sample.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -77,11 +93,36 @@ enum REQ_STATE {
     USED
 };
 
+enum OP_TYPE {
+    OP_REQUEST,
+    OP_CALLOC,
+    OP_ALIGNED,
+    OP_BATCH,
+    OP_ARENA,
+    OP_FREE,
+    OP_BATCHFREE,
+    OP_DESTROY,
+    OP_REALLOC
+};
+
+// one trace line; size 0 for a FREE, the new size for a REALLOC
+typedef struct op {
+    enum OP_TYPE type;
+    int id;
+    int size;
+    int align; // for an ALIGNED only
+    int count; // ids id to id + count - 1, for a BATCH or BATCHFREE
+    int arena; // for an ARENA or DESTROY only
+    int life;  // KMA_LIFE_XXX hint for a REQUEST, set by -l
+} op_t;
+
 typedef struct mem {
     int size;
     void *ptr;
     void *value; // to check correctness
     enum REQ_STATE state;
+    kma_heap_t *heap; // the arena's heap it came from, or NULL
+    kma_handle_t handle; // its handle under -c, or KMA_NO_HANDLE
 } mem_t;
 
 /************Global Variables*********************************************/
@@ -89,10 +130,28 @@ typedef struct mem {
 static int val = 0;
 
 /************Function Prototypes******************************************/
-void allocate();
+void load(char *);
+
+void hint(int);
+
+void run(kma_backend_t *, int, char *);
+
+void allocate(mem_t *, op_t *);
+
+void allocate_batch(mem_t *, op_t *);
 
 void deallocate();
 
+void deallocate_batch(mem_t *, op_t *);
+
+int destroy(mem_t *, op_t *);
+
+void reopen(mem_t *);
+
+long resident();
+
+void reallocate();
+
 void fill(char *, int);
 
 void check(char *, char *, int);
@@ -105,6 +164,20 @@ void pass();
 
 void fail();
 
+#ifdef LATENCY
+long elapsed_ns(struct timespec *, struct timespec *);
+
+int compare_long(const void *, const void *);
+
+void report_latency(char *, long *, int);
+#endif
+
+#ifdef CACHESTAT
+void cache_open();
+
+void cache_report(int);
+#endif
+
 /************External Declaration*****************************************/
 
 
@@ -113,11 +186,118 @@ void fail();
 
 int anyMismatches = 0;
 
-int currentAllocBytes = 0;
+long currentAllocBytes = 0;
 
 char *name = NULL;
 
+op_t *trace = NULL;
+
+int n_ops = 0;
+
+int n_req = 0;
+
+// arenas of the trace, numbered 0 to n_arenas - 1, and the heap each
+// one has until it is destroyed
+int n_arenas = 0;
+
+kma_heap_t **arenas = NULL;
+
+// REALLOCs resized in place and moved, and the bytes the moves copied
+int reallocInPlace = 0;
+
+int reallocMoved = 0;
+
+long reallocCopied = 0;
+
+// bytes in-place resizes did not have to copy
+long reallocNotCopied = 0;
+
+// bytes requested through CALLOC
+long callocBytes = 0;
+
+// requests and bytes made through ALIGNED
+int alignedRequests = 0;
+
+long alignedBytes = 0;
+
+// blocks allocated and freed through BATCH and BATCHFREE
+int batchAllocated = 0;
+
+int batchFreed = 0;
+
+// blocks allocated through ARENA, and those of them freed by DESTROY
+// rather than one by one
+int arenaAllocated = 0;
+
+int arenaReclaimed = 0;
+
+// REQUESTs hinted short- and long-lived, and the most pages in use at
+// once
+int shortHints = 0;
+
+int longHints = 0;
+
+int peakPages = 0;
+
+// blocks kma_compact() may move after each line, set by -c, and the
+// kma_pin() calls made to reach handle blocks
+int compaction = 0;
+
+long pins = 0;
+
+// the heap file of -p, closed and reopened halfway through the trace;
+// how long that took, and whether the pool moved
+char *heapFile = NULL;
+
+long heapCloseNs = 0;
+
+long heapReopenNs = 0;
+
+int heapMoved = 0;
+
+// the soft limit of -t, 0 to only measure; the most bytes held, and
+// of those in memory, sampled every RESIDENT_EVERY lines: the most, the
+// sum, and the most past both the limit and the bytes in use
+#define RESIDENT_EVERY 64
+
+long softLimit = -1;
+
+long peakHeld = 0;
+
+long peakResident = 0;
+
+double residentSum = 0;
+
+int residentSamples = 0;
+
+long residentExcess = 0;
+
+// the mean bytes between samples of -s, 0 for none; the most bytes
+// live at once, and the live bytes the samples stood for then
+long sampleRate = 0;
+
+long samplePeak = 0;
+
+long samplePeakEstimate = 0;
+
+#ifdef LATENCY
+long *mallocLatency = NULL;
+
+long *freeLatency = NULL;
+
+int mallocLatencyCount = 0;
+
+int freeLatencyCount = 0;
+#endif
+
+#ifdef CACHESTAT
+// cache-miss counter, enabled only around kma_malloc/kma_free
+int cacheFd = -1;
+#endif
+
 int main(int argc, char *argv[]) {
+    kma_backend_t *backend = kma_current;
+    int all = 0, magazine = 0, horizon = 0, opt;
 
     name = argv[0];
 
@@ -129,114 +309,474 @@ int main(int argc, char *argv[]) {
     printf("%s: Running in correctness mode\n", name);
 #endif
 
-    int n_req = 0, n_alloc = 0, n_dealloc = 0;
-    kma_page_stat_t *stat;
+    while ((opt = getopt(argc, argv, "a:ml:c:p:t:s:")) != -1) {
+        switch (opt) {
+        case 'a':
+            if (strcmp(optarg, "all") == 0) {
+                all = 1;
+            } else if ((backend = kma_backend_find(optarg)) == NULL) {
+                error("unknown backend", optarg);
+            }
+            break;
+        case 'm':
+            magazine = 1;
+            break;
+        case 'l':
+            if ((horizon = atoi(optarg)) <= 0) {
+                error("lifetime horizon is not a positive number of lines", optarg);
+            }
+            break;
+        case 'c':
+            if ((compaction = atoi(optarg)) <= 0) {
+                error("compaction moves is not a positive number", optarg);
+            }
+            break;
+        case 'p':
+            heapFile = optarg;
+            break;
+        case 't':
+            if ((softLimit = atol(optarg)) < 0) {
+                error("soft limit is a negative number of bytes", optarg);
+            }
+            break;
+        case 's':
+            if ((sampleRate = atol(optarg)) <= 0) {
+                error("sampling rate is not a positive number of bytes", optarg);
+            }
+            break;
+        default:
+            usage();
+        }
+    }
 
-#ifdef COMPETITION
-    double ratioSum = 0.0;
-    int ratioCount = 0;
-#endif
+    if (optind != argc - 1) {
+        usage();
+    }
 
-#ifndef COMPETITION
-    FILE *allocTrace = fopen("kma_output.dat", "w");
-    if (allocTrace == NULL) {
-        error("unable to open allocation output file", "kma_output.dat");
+    load(argv[optind]);
+
+    if (horizon) {
+        hint(horizon);
     }
-    fprintf(allocTrace, "0 0 0\n");
-#endif
 
-    if (argc != 2) {
-        usage();
+    if (!all) {
+        run(backend, magazine, "kma_output.dat");
+    }
+
+    // one forked run per backend: a crash or a leaked page in one
+    // does not affect the others, and the trace is parsed only once
+    kma_backend_t **b;
+    int failed = 0;
+    for (b = kma_backends; *b; b++) {
+        char output[64];
+        int status;
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            error("unable to fork", (*b)->name);
+        }
+        if (pid == 0) {
+            snprintf(output, sizeof(output), "kma_output.%s.dat", (*b)->name);
+            run(*b, magazine, output);
+        }
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("Backend %s: FAILED\n", (*b)->name);
+            failed = 1;
+        }
     }
 
-    FILE *f_test = fopen(argv[1], "r");
+    if (failed) {
+        fail();
+    }
+    pass();
+    return 0;
+}
+
+void load(char *file) {
+    FILE *f_test = fopen(file, "r");
     if (f_test == NULL) {
-        error("unable to open input test file", argv[1]);
+        error("unable to open input test file", file);
     }
 
     // Get the number of requests in the trace file
-    // Allocate some memory...
     int status = fscanf(f_test, "%d\n", &n_req);
     if (status != 1) {
         error("Couldn't read number of requests at head of file", "");
     }
 
-    mem_t *requests = malloc((n_req / 2) * sizeof(mem_t));
-    memset(requests, 0, (n_req / 2) * sizeof(mem_t));
+    trace = malloc(n_req * sizeof(op_t));
+    assert(trace != NULL);
 
     char command[16];
-    int req_id, req_size, index = 1;
+    int req_id, req_size, req_align, req_count, req_arena = 0;
+    enum OP_TYPE type;
 
-    // Parse the lines in the file, and call allocate or
-    // deallocate accordingly.
+    // Parse the lines in the file into trace[]
     while (fscanf(f_test, "%10s", command) == 1) {
+        if (n_ops == n_req) {
+            error("more commands than announced at head of file", "");
+        }
         if (strcmp(command, "REQUEST") == 0) {
-
             if (fscanf(f_test, "%d %d", &req_id, &req_size) != 2) {
                 error("Not enough arguments to REQUEST", "");
             }
-
-            assert(req_id >= 0 && req_id < n_req);
-
-            allocate(requests, req_id, req_size);
-            n_alloc++;
+            type = OP_REQUEST;
+        } else if (strcmp(command, "CALLOC") == 0) {
+            if (fscanf(f_test, "%d %d", &req_id, &req_size) != 2) {
+                error("Not enough arguments to CALLOC", "");
+            }
+            type = OP_CALLOC;
+        } else if (strcmp(command, "ALIGNED") == 0) {
+            if (fscanf(f_test, "%d %d %d", &req_id, &req_size, &req_align) != 3) {
+                error("Not enough arguments to ALIGNED", "");
+            }
+            if (req_align <= 0 || (req_align & (req_align - 1)) || req_align > PAGESIZE) {
+                error("ALIGNED alignment is not a power of two up to a page", command);
+            }
+            type = OP_ALIGNED;
+        } else if (strcmp(command, "BATCH") == 0) {
+            if (fscanf(f_test, "%d %d %d", &req_id, &req_count, &req_size) != 3) {
+                error("Not enough arguments to BATCH", "");
+            }
+            type = OP_BATCH;
+        } else if (strcmp(command, "BATCHFREE") == 0) {
+            if (fscanf(f_test, "%d %d", &req_id, &req_count) != 2) {
+                error("Not enough arguments to BATCHFREE", "");
+            }
+            req_size = 0;
+            type = OP_BATCHFREE;
+        } else if (strcmp(command, "ARENA") == 0) {
+            if (fscanf(f_test, "%d %d %d", &req_arena, &req_id, &req_size) != 3) {
+                error("Not enough arguments to ARENA", "");
+            }
+            type = OP_ARENA;
+        } else if (strcmp(command, "DESTROY") == 0) {
+            if (fscanf(f_test, "%d", &req_arena) != 1) {
+                error("Not enough arguments to DESTROY", "");
+            }
+            req_id = 0;
+            req_size = 0;
+            type = OP_DESTROY;
         } else if (strcmp(command, "FREE") == 0) {
             if (fscanf(f_test, "%d", &req_id) != 1) {
                 error("Not enough arguments to FREE", "");
             }
+            req_size = 0;
+            type = OP_FREE;
+        } else if (strcmp(command, "REALLOC") == 0) {
+            if (fscanf(f_test, "%d %d", &req_id, &req_size) != 2) {
+                error("Not enough arguments to REALLOC", "");
+            }
+            type = OP_REALLOC;
+        } else {
+            error("unknown command type:", command);
+        }
+
+        if (type != OP_BATCH && type != OP_BATCHFREE) {
+            req_count = 1;
+        }
+
+        // ids are below half the announced requests, as each takes two
+        assert(req_id >= 0 && req_count > 0 && req_id + req_count <= n_req / 2);
 
-            assert(req_id >= 0 && req_id < n_req);
+        if (type == OP_ARENA || type == OP_DESTROY) {
+            assert(req_arena >= 0 && req_arena < n_req / 2);
+            if (req_arena >= n_arenas) {
+                n_arenas = req_arena + 1;
+            }
+        }
+
+        trace[n_ops].type = type;
+        trace[n_ops].id = req_id;
+        trace[n_ops].size = req_size;
+        trace[n_ops].align = type == OP_ALIGNED ? req_align : 0;
+        trace[n_ops].count = req_count;
+        trace[n_ops].arena = type == OP_ARENA || type == OP_DESTROY ? req_arena : 0;
+        trace[n_ops].life = KMA_LIFE_ANY;
+        n_ops++;
+    }
+
+    fclose(f_test);
+}
+
+// gives each REQUEST the lifetime hint its allocation site would have
+// learned: short if its FREE is at most horizon lines later, long if not
+void hint(int horizon) {
+    int *start = malloc((n_req / 2) * sizeof(int));
+    int i;
+
+    assert(start != NULL);
+    for (i = 0; i < n_req / 2; i++) {
+        start[i] = -1;
+    }
+    for (i = 0; i < n_ops; i++) {
+        if (trace[i].type == OP_REQUEST) {
+            trace[i].life = KMA_LIFE_LONG;
+            start[trace[i].id] = i;
+        } else if (trace[i].type == OP_FREE && start[trace[i].id] >= 0) {
+            if (i - start[trace[i].id] <= horizon) {
+                trace[start[trace[i].id]].life = KMA_LIFE_SHORT;
+            }
+            start[trace[i].id] = -1;
+        } else if (trace[i].type == OP_REALLOC) {
+            // a moved block no longer is where its hint placed it
+            start[trace[i].id] = -1;
+        }
+    }
+    for (i = 0; i < n_ops; i++) {
+        if (trace[i].life == KMA_LIFE_SHORT) {
+            shortHints++;
+        } else if (trace[i].life == KMA_LIFE_LONG) {
+            longHints++;
+        }
+    }
+    free(start);
+}
+
+void run(kma_backend_t *backend, int magazine, char *output) {
+    int n_alloc = 0, n_dealloc = 0, i;
+    kma_page_stat_t *stat;
+
+    printf("Backend: %s%s\n", backend->name, magazine ? " behind magazines" : "");
+    if (magazine) {
+        kma_magazine_wrap(backend);
+        backend = &kma_magazine_backend;
+    }
+    kma_current = backend;
+
+    if (softLimit > 0) {
+        kma_limit(softLimit);
+    }
+
+    if (sampleRate) {
+        kma_sample(sampleRate);
+    }
 
+    if (heapFile) {
+        if (n_arenas) {
+            error("arenas are not kept in a heap file", heapFile);
+        }
+        if (!kma_file_create(heapFile)) {
+            error("unable to create the heap file", heapFile);
+        }
+    }
+
+#ifdef COMPETITION
+    double ratioSum = 0.0;
+    int ratioCount = 0;
+#endif
+
+#ifndef COMPETITION
+    FILE *allocTrace = fopen(output, "w");
+    if (allocTrace == NULL) {
+        error("unable to open allocation output file", output);
+    }
+    fprintf(allocTrace, "0 0 0\n");
+#endif
+
+    mem_t *requests = malloc((n_req / 2) * sizeof(mem_t));
+    memset(requests, 0, (n_req / 2) * sizeof(mem_t));
+
+    arenas = calloc(n_arenas + 1, sizeof(kma_heap_t *));
+    assert(arenas != NULL);
+
+#ifdef CACHESTAT
+    cache_open();
+#endif
+
+#ifdef LATENCY
+    mallocLatency = malloc((n_req / 2) * sizeof(long));
+    freeLatency = malloc((n_req / 2) * sizeof(long));
+    assert(mallocLatency != NULL && freeLatency != NULL);
+#endif
+
+    for (i = 0; i < n_ops; i++) {
+        int req_id = trace[i].id;
+
+        if (heapFile && i == n_ops / 2) {
+            reopen(requests);
+        }
+
+        if (trace[i].type == OP_REQUEST || trace[i].type == OP_CALLOC || trace[i].type == OP_ALIGNED
+            || trace[i].type == OP_ARENA) {
+            allocate(requests, &trace[i]);
+            n_alloc++;
+        } else if (trace[i].type == OP_BATCH) {
+            allocate_batch(requests, &trace[i]);
+            n_alloc += trace[i].count;
+        } else if (trace[i].type == OP_FREE) {
             deallocate(requests, req_id);
             n_dealloc++;
+        } else if (trace[i].type == OP_BATCHFREE) {
+            deallocate_batch(requests, &trace[i]);
+            n_dealloc += trace[i].count;
+        } else if (trace[i].type == OP_DESTROY) {
+            n_dealloc += destroy(requests, &trace[i]);
         } else {
-            error("unknown command type:", command);
+            reallocate(requests, req_id, trace[i].size);
+        }
+
+        if (compaction) {
+            kma_compact(compaction);
+        }
+
+        if (softLimit >= 0) {
+            long held = kma_held();
+            if (held > peakHeld) {
+                peakHeld = held;
+            }
+            if (i % RESIDENT_EVERY == 0) {
+                long bytes = resident();
+                long used = (long) page_stats()->num_in_use * PAGESIZE + kma_large_mapped - kma_large_cached;
+                if (bytes > peakResident) {
+                    peakResident = bytes;
+                }
+                if (bytes - (used > softLimit ? used : softLimit) > residentExcess) {
+                    residentExcess = bytes - (used > softLimit ? used : softLimit);
+                }
+                residentSum += bytes;
+                residentSamples++;
+            }
+        }
+
+        // the profile of the peak is the one that tells what to cut
+        if (sampleRate && currentAllocBytes > samplePeak) {
+            samplePeak = currentAllocBytes;
+            samplePeakEstimate = kma_sample_snapshot();
         }
 
         stat = page_stats();
-        int totalBytes = stat->num_in_use * stat->page_size;
+        // mappings of the large tier count like pages
+        long totalBytes = (long) stat->num_in_use * stat->page_size + kma_large_mapped;
+
+        if (stat->num_in_use > peakPages) {
+            peakPages = stat->num_in_use;
+        }
 
 
 #ifdef COMPETITION
         if(req_id < n_req && n_alloc != n_dealloc) {
             // We can calculate the ratio of wasted to used memory here.
 
-            int wastedBytes = totalBytes - currentAllocBytes;
+            long wastedBytes = totalBytes - currentAllocBytes;
             ratioSum += ((double) wastedBytes) / currentAllocBytes;
             ratioCount += 1;
         }
 #endif
 
 #ifndef COMPETITION
-        fprintf(allocTrace, "%d %d %d\n", index, currentAllocBytes, totalBytes);
+        fprintf(allocTrace, "%d %ld %ld\n", i + 1, currentAllocBytes, totalBytes);
 #endif
-
-        index += 1;
     }
 
 #ifndef COMPETITION
     fclose(allocTrace);
 #endif
 
+    // cached objects still hold their pages
+    if (backend->flush) {
+        backend->flush();
+    }
+    kma_large_flush();
 
     stat = page_stats();
 
     printf("Page Requested/Freed/In Use: %5d/%5d/%5d\n", stat->num_requested, stat->num_freed, stat->num_in_use);
+    printf("Peak Pages In Use: %5d\n", peakPages);
 
     if (stat->num_requested != stat->num_freed || stat->num_in_use != 0) {
         error("not all pages freed", "");
     }
 
+    if (kma_large_mapped) {
+        error("not all large mappings unmapped", "");
+    }
+
+    if (heapFile && !kma_file_close()) {
+        error("unable to close the heap file", heapFile);
+    }
+
     if (anyMismatches) {
         error("there were memory mismatches", "");
     }
 
+    if (reallocInPlace + reallocMoved) {
+        printf("Realloc In Place/Moved: %5d/%5d\n", reallocInPlace, reallocMoved);
+        printf("Realloc Bytes Copied/Not Copied: %ld/%ld\n", reallocCopied, reallocNotCopied);
+    }
+
+    if (callocBytes) {
+        printf("Calloc Bytes Cleared/Known Zero: %ld/%ld\n", callocBytes - kma_zero_avoided, kma_zero_avoided);
+    }
+
+    // what alignment costs in pages shows in the competition ratio
+    if (alignedRequests) {
+        printf("Aligned Requests/Bytes: %d/%ld\n", alignedRequests, alignedBytes);
+    }
+
+    if (batchAllocated + batchFreed) {
+        printf("Batch Allocated/Freed: %5d/%5d\n", batchAllocated, batchFreed);
+    }
+
+    if (shortHints + longHints) {
+        printf("Lifetime Hints Short/Long: %5d/%5d\n", shortHints, longHints);
+    }
+
+    if (arenaAllocated) {
+        printf("Arena Allocated/Reclaimed: %5d/%5d\n", arenaAllocated, arenaReclaimed);
+    }
+
+    if (kma_large_runs + kma_large_maps + kma_large_hits) {
+        printf("Large Runs/Maps/Cache Hits: %5d/%5d/%5d\n", kma_large_runs, kma_large_maps, kma_large_hits);
+    }
+
+    if (softLimit >= 0) {
+        printf("Soft Limit/Trims: %ld/%d\n", softLimit, kma_trims);
+        printf("Peak Held/Resident Bytes: %ld/%ld\n", peakHeld, peakResident);
+        printf("Average Resident/Most Past Limit and Use: %.0f/%ld\n", residentSum / residentSamples, residentExcess);
+    }
+
+    if (heapFile) {
+        printf("Heap File Close/Reopen: %ld/%ld ns%s\n", heapCloseNs, heapReopenNs, heapMoved ? ", pool moved" : "");
+    }
+
+    if (sampleRate) {
+        char profile[64];
+        int sites;
+
+        snprintf(profile, sizeof(profile), "kma_sample.%s.folded", backend->name);
+        sites = kma_sample_dump(profile, KMA_SAMPLE_FOLDED, TRUE);
+        snprintf(profile, sizeof(profile), "kma_sample.%s.heap", backend->name);
+        if (sites < 0 || kma_sample_dump(profile, KMA_SAMPLE_PPROF, TRUE) < 0) {
+            error("unable to write the heap profile", profile);
+        }
+        printf("Samples Taken/Dropped/Peak Sites: %d/%d/%d\n", kma_sample_taken, kma_sample_dropped, sites);
+        printf("Peak Live Bytes/Sampled Estimate: %ld/%ld\n", samplePeak, samplePeakEstimate);
+    }
+
+    if (compaction) {
+        printf("Compaction Moves/Pages Freed: %5d/%5d\n", kma_compact_moves, kma_compact_released);
+        printf("Handle Pins: %ld\n", pins);
+    }
+
 #ifdef COMPETITION
     printf("Competition average ratio: %f\n", ratioSum / ratioCount);
 #endif
 
+#ifdef CACHESTAT
+    cache_report(n_alloc + n_dealloc);
+#endif
+
+#ifdef LATENCY
+    report_latency("kma_malloc", mallocLatency, mallocLatencyCount);
+    report_latency("kma_free", freeLatency, freeLatencyCount);
+    free(mallocLatency);
+    free(freeLatency);
+#endif
+
     pass();
-    return 0;
 }
 
 void fail() {
@@ -250,7 +790,7 @@ void pass() {
 }
 
 void usage() {
-    printf("Usage: %s traceFile\n", name);
+    printf("Usage: %s [-a backend|all] [-m] [-l horizon] [-c moves] [-p heapFile] [-t softLimit] [-s sampleRate] traceFile\n", name);
     exit(0);
 }
 
@@ -259,30 +799,104 @@ void error(char *message, char *arg) {
     fail();
 }
 
-void allocate(mem_t *requests, int req_id, int req_size) {
-    mem_t *newPtr = &requests[req_id];
+// the block of a handle, counted as one of the pins -c costs
+static void *pin(kma_handle_t handle) {
+    pins++;
+    return kma_pin(handle);
+}
 
-    assert(newPtr->state == FREE);
+// whether a request of size must get a block: all up to a page less
+// its slack, and past a page all that the large tier serves, which
+// arena blocks and handles do not reach
+static int allocatable(int size, int slack, int large) {
+    if (size <= PAGESIZE - slack) {
+        return 1;
+    }
+    return large && size > KMA_LARGE_MIN;
+}
 
-    newPtr->size = req_size;
-    newPtr->ptr = kma_malloc(newPtr->size);
+// the call an allocating trace line stands for; under -c a REQUEST of
+// up to a page is a handle, pinned until its block has been filled
+static void *alloc(op_t *op, kma_handle_t *handle) {
+    *handle = KMA_NO_HANDLE;
+    if (op->type == OP_REQUEST && compaction && op->size <= PAGESIZE) {
+        *handle = kma_halloc(op->size);
+        return *handle ? pin(*handle) : NULL;
+    }
+    if (op->type == OP_CALLOC) {
+        return kma_calloc(op->size);
+    }
+    if (op->type == OP_ALIGNED) {
+        return kma_memalign(op->align, op->size);
+    }
+    if (op->life) {
+        return kma_malloc_hint(op->size, op->life);
+    }
+    if (op->type == OP_ARENA) {
+        // an arena gets a heap when its first block is allocated
+        if (!arenas[op->arena] && !(arenas[op->arena] = kma_heap_create())) {
+            return NULL;
+        }
+        return kma_heap_malloc(arenas[op->arena], op->size);
+    }
+    return kma_malloc(op->size);
+}
 
-    // Accept a NULL response in some cases...
-    if (!(((newPtr->ptr != NULL) && (newPtr->size <= (PAGESIZE - sizeof(void *))))
-          || ((newPtr->ptr == NULL) && (newPtr->size > (PAGESIZE - sizeof(void *)))))) {
-        error("got NULL from kma_malloc for alloc'able request", "");
+// the call a FREE stands for
+static void dealloc(mem_t *cur) {
+    if (cur->handle) {
+        kma_hfree(cur->handle);
+    } else if (cur->heap) {
+        kma_heap_free(cur->heap, cur->ptr, cur->size);
+    } else {
+        kma_free(cur->ptr, cur->size);
     }
+}
 
-    if (newPtr->ptr == NULL) {
-        return;
+// the checks and bookkeeping for a block op got from the allocator
+static void accept(mem_t *newPtr, op_t *op, void *ptr) {
+    int req_size = op->size;
+    int zero = op->type == OP_CALLOC;
+
+    assert(req_size > 0);
+
+    newPtr->size = req_size;
+    newPtr->ptr = ptr;
+    newPtr->heap = op->type == OP_ARENA ? arenas[op->arena] : NULL;
+    newPtr->handle = KMA_NO_HANDLE;
+
+    if (op->align && ((long) newPtr->ptr & (op->align - 1))) {
+        error("got misaligned memory from kma_memalign", "");
     }
 
     currentAllocBytes += req_size;
 
+    if (zero) {
+        callocBytes += req_size;
+    }
+
+    if (op->align) {
+        alignedRequests++;
+        alignedBytes += req_size;
+    }
+
+    if (newPtr->heap) {
+        arenaAllocated++;
+    }
+
 #ifndef COMPETITION
     // Only run the actual memory accesses/copies/checks if we're
     // testing for correctness.
 
+    if (zero) {
+        int i;
+        for (i = 0; i < req_size; i++) {
+            if (((char *) newPtr->ptr)[i]) {
+                error("got memory that is not zero from kma_calloc", "");
+            }
+        }
+    }
+
     newPtr->value = malloc(newPtr->size);
     assert(newPtr->value != NULL);
 
@@ -299,29 +913,336 @@ void allocate(mem_t *requests, int req_id, int req_size) {
     newPtr->state = USED;
 }
 
-void deallocate(mem_t *requests, int req_id) {
-    mem_t *cur = &requests[req_id];
+void allocate(mem_t *requests, op_t *op) {
+    mem_t *newPtr = &requests[op->id];
+    // an aligned block may start up to its alignment, or a cache line
+    // for small ones, into a page; an arena block has no header
+    int slack = op->align > 64 ? op->align : op->align ? 64 : op->type == OP_ARENA ? 0 : (int) sizeof(void *);
+    kma_handle_t handle;
+    void *ptr;
+
+    assert(newPtr->state == FREE);
+
+#ifdef LATENCY
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ptr = alloc(op, &handle);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    mallocLatency[mallocLatencyCount++] = elapsed_ns(&start, &end);
+#elif defined(CACHESTAT)
+    ioctl(cacheFd, PERF_EVENT_IOC_ENABLE, 0);
+    ptr = alloc(op, &handle);
+    ioctl(cacheFd, PERF_EVENT_IOC_DISABLE, 0);
+#else
+    ptr = alloc(op, &handle);
+#endif
+
+    // Accept a NULL response in some cases...
+    if ((ptr != NULL) != allocatable(op->size, slack, op->type != OP_ARENA)) {
+        error("got NULL from kma_malloc for alloc'able request", "");
+    }
+
+    if (ptr != NULL) {
+        accept(newPtr, op, ptr);
+    }
+    if (handle) {
+        newPtr->handle = handle;
+        kma_unpin(handle);
+    }
+}
+
+void allocate_batch(mem_t *requests, op_t *op) {
+    void **ptrs = malloc(op->count * sizeof(void *));
+    int got, i;
+
+    assert(ptrs != NULL);
+    for (i = 0; i < op->count; i++) {
+        assert(requests[op->id + i].state == FREE);
+    }
+
+#ifdef LATENCY
+    struct timespec start, end;
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    got = kma_malloc_batch(op->size, op->count, ptrs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    // each block is charged its share of the call
+    for (i = 0; i < op->count; i++) {
+        mallocLatency[mallocLatencyCount++] = elapsed_ns(&start, &end) / op->count;
+    }
+#elif defined(CACHESTAT)
+    ioctl(cacheFd, PERF_EVENT_IOC_ENABLE, 0);
+    got = kma_malloc_batch(op->size, op->count, ptrs);
+    ioctl(cacheFd, PERF_EVENT_IOC_DISABLE, 0);
+#else
+    got = kma_malloc_batch(op->size, op->count, ptrs);
+#endif
+
+    // the whole batch, or nothing for a size no single call could get
+    int all = allocatable(op->size, sizeof(void *), 1);
+    if (!((all && got == op->count) || (!all && got == 0))) {
+        error("got a short batch from kma_malloc_batch for alloc'able requests", "");
+    }
+
+    for (i = 0; i < got; i++) {
+        accept(&requests[op->id + i], op, ptrs[i]);
+    }
+    batchAllocated += got;
+    free(ptrs);
+}
+
+// the checks before a block of the trace is freed
+static void retire(mem_t *cur) {
     assert(cur->state == USED);
     assert(cur->size > 0);
 
 #ifndef COMPETITION
     // Only run the memory checks if we're testing for correctness.
 
-    // check memory
+    // check memory, where compaction may have moved it
+    if (cur->handle) {
+        cur->ptr = pin(cur->handle);
+    }
     check((char *) cur->ptr, (char *) cur->value, cur->size);
+    if (cur->handle) {
+        kma_unpin(cur->handle);
+    }
 
     // free memory
     free(cur->value);
 #endif
+}
 
-    kma_free(cur->ptr, cur->size);
+void deallocate(mem_t *requests, int req_id) {
+    mem_t *cur = &requests[req_id];
+
+    retire(cur);
+
+#ifdef LATENCY
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    dealloc(cur);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    freeLatency[freeLatencyCount++] = elapsed_ns(&start, &end);
+#elif defined(CACHESTAT)
+    ioctl(cacheFd, PERF_EVENT_IOC_ENABLE, 0);
+    dealloc(cur);
+    ioctl(cacheFd, PERF_EVENT_IOC_DISABLE, 0);
+#else
+    dealloc(cur);
+#endif
 
     currentAllocBytes -= cur->size;
 
     cur->state = FREE;
 }
 
+void deallocate_batch(mem_t *requests, op_t *op) {
+    void **ptrs = malloc(op->count * sizeof(void *));
+    kma_size_t *sizes = malloc(op->count * sizeof(kma_size_t));
+    int i;
+
+    assert(ptrs != NULL && sizes != NULL);
+    for (i = 0; i < op->count; i++) {
+        mem_t *cur = &requests[op->id + i];
+        retire(cur);
+        ptrs[i] = cur->ptr;
+        sizes[i] = cur->size;
+    }
+
+#ifdef LATENCY
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    kma_free_batch(ptrs, sizes, op->count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (i = 0; i < op->count; i++) {
+        freeLatency[freeLatencyCount++] = elapsed_ns(&start, &end) / op->count;
+    }
+#elif defined(CACHESTAT)
+    ioctl(cacheFd, PERF_EVENT_IOC_ENABLE, 0);
+    kma_free_batch(ptrs, sizes, op->count);
+    ioctl(cacheFd, PERF_EVENT_IOC_DISABLE, 0);
+#else
+    kma_free_batch(ptrs, sizes, op->count);
+#endif
+
+    for (i = 0; i < op->count; i++) {
+        currentAllocBytes -= sizes[i];
+        requests[op->id + i].state = FREE;
+    }
+    batchFreed += op->count;
+    free(ptrs);
+    free(sizes);
+}
+
+// frees every block of the arena that is still in use along with its
+// heap, and returns how many there were
+int destroy(mem_t *requests, op_t *op) {
+    kma_heap_t *heap = arenas[op->arena];
+    int reclaimed = 0, i;
+
+    if (!heap) {
+        error("DESTROY of an arena without blocks", "");
+    }
+    for (i = 0; i < n_req / 2; i++) {
+        mem_t *cur = &requests[i];
+        if (cur->state == USED && cur->heap == heap) {
+            retire(cur);
+            currentAllocBytes -= cur->size;
+            cur->state = FREE;
+            reclaimed++;
+        }
+    }
+
+#ifdef LATENCY
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    kma_heap_destroy(heap);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    // the one call frees them all
+    freeLatency[freeLatencyCount++] = elapsed_ns(&start, &end);
+#elif defined(CACHESTAT)
+    ioctl(cacheFd, PERF_EVENT_IOC_ENABLE, 0);
+    kma_heap_destroy(heap);
+    ioctl(cacheFd, PERF_EVENT_IOC_DISABLE, 0);
+#else
+    kma_heap_destroy(heap);
+#endif
+
+    arenas[op->arena] = NULL;
+    arenaReclaimed += reclaimed;
+    return reclaimed;
+}
+
+// the bytes of the pool in memory now, and the mappings of the large
+// tier, taken as all in memory
+long resident() {
+    static unsigned char vec[MAXPAGES * (PAGESIZE / 4096)];
+    long page = sysconf(_SC_PAGESIZE), bytes = kma_large_mapped, i;
+
+    if (kma_pool && mincore(kma_pool, MAXPAGES * PAGESIZE, vec) == 0) {
+        for (i = 0; i < MAXPAGES * PAGESIZE / page; i++) {
+            bytes += (vec[i] & 1) * page;
+        }
+    }
+    return bytes;
+}
+
+// closes the heap file and maps it again away from where the pool was,
+// then moves the blocks of the trace along and checks them
+void reopen(mem_t *requests) {
+    void *old = kma_pool;
+    struct timespec start, end;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!kma_file_close()) {
+        error("unable to close the heap file", heapFile);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    heapCloseNs = (end.tv_sec - start.tv_sec) * 1000000000L + end.tv_nsec - start.tv_nsec;
+
+    // the old place of the pool stays taken, so that it has to move
+    void *hold = mmap(old, MAXPAGES * PAGESIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!kma_file_reopen(heapFile)) {
+        error("unable to reopen the heap file", heapFile);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    heapReopenNs = (end.tv_sec - start.tv_sec) * 1000000000L + end.tv_nsec - start.tv_nsec;
+
+    if (hold != MAP_FAILED) {
+        munmap(hold, MAXPAGES * PAGESIZE);
+    }
+    heapMoved = kma_pool != old;
+
+    for (i = 0; i < n_req / 2; i++) {
+        mem_t *cur = &requests[i];
+        if (cur->state != USED) {
+            continue;
+        }
+        if (!cur->handle && cur->ptr >= old && cur->ptr < old + MAXPAGES * PAGESIZE) {
+            cur->ptr = kma_pool + (cur->ptr - old);
+        }
+#ifndef COMPETITION
+        void *ptr = cur->handle ? kma_pin(cur->handle) : cur->ptr;
+        check((char *) ptr, (char *) cur->value, cur->size);
+        if (cur->handle) {
+            kma_unpin(cur->handle);
+        }
+#endif
+    }
+}
+
+void reallocate(mem_t *requests, int req_id, int req_size) {
+    mem_t *cur = &requests[req_id];
+
+    assert(cur->state == USED);
+    assert(req_size > 0);
+
+    if (cur->heap) {
+        error("REALLOC of an arena block", "");
+    }
+
+    if (cur->handle) {
+        cur->ptr = pin(cur->handle);
+        kma_unpin(cur->handle);
+    }
+
+#ifndef COMPETITION
+    check((char *) cur->ptr, (char *) cur->value, cur->size);
+#endif
+
+    void *ptr;
+    if (cur->handle) {
+        // the block stays unpinned, so it may move
+        ptr = kma_hrealloc(cur->handle, req_size) ? pin(cur->handle) : NULL;
+    } else {
+        ptr = kma_realloc(cur->ptr, cur->size, req_size);
+    }
+
+    // ...and the same NULL responses as allocate(); the old block stays
+    if ((ptr != NULL) != allocatable(req_size, sizeof(void *), !cur->handle)) {
+        error("got NULL from kma_realloc for alloc'able request", "");
+    }
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    int kept = cur->size < req_size ? cur->size : req_size;
+    if (ptr == cur->ptr) {
+        reallocInPlace++;
+        reallocNotCopied += kept;
+    } else {
+        reallocMoved++;
+        reallocCopied += kept;
+    }
+
+    currentAllocBytes += req_size - cur->size;
+
+#ifndef COMPETITION
+    // the bytes kept must have survived, the rest gets fresh values
+    check((char *) ptr, (char *) cur->value, kept);
+    cur->value = realloc(cur->value, req_size);
+    assert(cur->value != NULL);
+    fill((char *) ptr + kept, req_size - kept);
+    bcopy(ptr, cur->value, req_size);
+#endif
+
+    if (cur->handle) {
+        kma_unpin(cur->handle);
+    }
+
+    cur->ptr = ptr;
+    cur->size = req_size;
+}
+
 void fill(char *ptr, int size) {
     int i;
 
@@ -340,3 +1261,57 @@ void check(char *lhs, char *rhs, int size) {
         }
     }
 }
+
+#ifdef LATENCY
+long elapsed_ns(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000000L + (end->tv_nsec - start->tv_nsec);
+}
+
+int compare_long(const void *lhs, const void *rhs) {
+    long l = *((const long *) lhs);
+    long r = *((const long *) rhs);
+
+    return (l > r) - (l < r);
+}
+
+// Print the tail of a latency distribution; the samples are sorted in place.
+void report_latency(char *what, long *samples, int count) {
+    if (count == 0) {
+        return;
+    }
+
+    qsort(samples, count, sizeof(long), compare_long);
+
+    printf("%s latency (ns) p50/p99/p999/max: %ld/%ld/%ld/%ld\n", what,
+           samples[count / 2], samples[(int) (count * 0.99)],
+           samples[(int) (count * 0.999)], samples[count - 1]);
+}
+#endif
+
+#ifdef CACHESTAT
+void cache_open() {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    cacheFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void cache_report(int ops) {
+    long long misses;
+
+    if (cacheFd < 0 || read(cacheFd, &misses, sizeof(misses)) != sizeof(misses)) {
+        printf("Cache misses per operation: unavailable (no hardware counter)\n");
+        return;
+    }
+
+    close(cacheFd);
+    printf("Cache misses per operation: %f\n", ((double) misses) / ops);
+}
+#endif
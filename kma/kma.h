@@ -72,7 +72,13 @@
 #define EXTERN extern
 #endif
 
-typedef int kma_size_t;
+// 64 bits, for objects of the large tier past a page
+typedef long kma_size_t;
+
+// the lifetime hints of kma_malloc_hint()
+#define KMA_LIFE_ANY 0
+#define KMA_LIFE_SHORT 1
+#define KMA_LIFE_LONG 2
 
 /************Global Variables*********************************************/
 
@@ -100,6 +106,131 @@ EXTERN void *kma_malloc(kma_size_t size);
  ***********************************************************************/
 EXTERN void kma_free(void *, kma_size_t size);
 
+/***********************************************************************
+ *  Title: Allocates zeroed kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Like kma_malloc(), but the memory is zero filled; bytes
+ *             the allocator knows to be untouched since their page was
+ *             mapped are not cleared again
+ *    Input: the size
+ *    Output: the zeroed memory of the specified size or NULL on failure
+ ***********************************************************************/
+EXTERN void *kma_calloc(kma_size_t size);
+
+/***********************************************************************
+ *  Title: Allocates aligned kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Like kma_malloc(), but the memory starts on a multiple
+ *             of alignment; it is freed with kma_free() and the same
+ *             size
+ *    Input: the alignment, a power of two no larger than a page, and
+ *           the size
+ *    Output: the aligned memory of the specified size or NULL on
+ *            failure
+ ***********************************************************************/
+EXTERN void *kma_memalign(kma_size_t alignment, kma_size_t size);
+
+/***********************************************************************
+ *  Title: Allocates a batch of kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates n blocks of size bytes each, as n calls to
+ *             kma_malloc() would, but the size class is looked up once
+ *             and blocks are taken from a page a run at a time
+ *    Input: the size, the number of blocks, and the array of n
+ *           pointers to fill
+ *    Output: the number of blocks now in out[0...], which is less
+ *            than n only on failure
+ ***********************************************************************/
+EXTERN int kma_malloc_batch(kma_size_t size, int n, void **out);
+
+/***********************************************************************
+ *  Title: Frees a batch of kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Frees n blocks, as n calls to kma_free() would; blocks
+ *             of one page that follow each other in ptrs are given
+ *             back together
+ *    Input: the pointers to the memory spaces, their sizes, and the
+ *           number of blocks
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_free_batch(void **ptrs, kma_size_t *sizes, int n);
+
+/***********************************************************************
+ *  Title: Allocates kernel memory with a lifetime hint
+ * ---------------------------------------------------------------------
+ *    Purpose: Like kma_malloc(), but the allocator may place the
+ *             block by how long it is expected to live: short-lived
+ *             blocks kept apart from the others let their pages empty
+ *             and be freed sooner
+ *    Input: the size, and KMA_LIFE_SHORT, KMA_LIFE_LONG or
+ *           KMA_LIFE_ANY
+ *    Output: the allocated memory of the specified size or NULL on
+ *            failure; it is freed with kma_free()
+ ***********************************************************************/
+EXTERN void *kma_malloc_hint(kma_size_t size, int lifetime);
+
+/***********************************************************************
+ *  Title: Resizes kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Changes the size of the memory space pointed to by ptr
+ *             from old_size to new_size bytes. The space is grown or
+ *             shrunk in place when the allocator can do so; otherwise
+ *             it is moved and the first min(old_size, new_size) bytes
+ *             are copied. A NULL ptr behaves like kma_malloc()
+ *    Input: the pointer to the memory space, its current size, the
+ *           new size
+ *    Output: the memory space, which may differ from ptr, or NULL on
+ *            failure, in which case ptr is left as it was
+ ***********************************************************************/
+EXTERN void *kma_realloc(void *ptr, kma_size_t old_size, kma_size_t new_size);
+
+/***********************************************************************
+ *  Title: Memory held
+ * ---------------------------------------------------------------------
+ *    Purpose: Counts what the allocator holds of the system's memory:
+ *             pool pages in use or freed but not given back, and the
+ *             mappings of the large tier
+ *    Input: none
+ *    Output: the bytes held
+ ***********************************************************************/
+EXTERN long kma_held();
+
+/***********************************************************************
+ *  Title: Trims kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Has the backend flush what it caches, empties the cache
+ *             of large mappings and gives the memory of free pages
+ *             back to the system, until at most target bytes are held
+ *             or nothing more can go; under the magazine layer, other
+ *             threads give back their magazines on their next call
+ *    Input: the bytes the allocator may go on holding
+ *    Output: the bytes held now
+ ***********************************************************************/
+EXTERN long kma_trim(long target);
+
+/***********************************************************************
+ *  Title: Sets a soft memory limit
+ * ---------------------------------------------------------------------
+ *    Purpose: Makes kma_free() and kma_free_batch() trim once more than
+ *             bytes are held and enough of that is cached to be worth
+ *             it; blocks in use may still take the allocator past it
+ *    Input: the limit, or 0 for none
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_limit(long bytes);
+
+/***********************************************************************
+ *  Title: Trims under memory pressure
+ * ---------------------------------------------------------------------
+ *    Purpose: Makes kma_free() look at /proc/pressure/memory every few
+ *             thousand calls and trim all it can while the share of
+ *             time some task stalled on memory, over the last 10
+ *             seconds, is at least avg10 percent
+ *    Input: the threshold, or a negative one to stop watching
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_pressure(double avg10);
+
 /************External Declaration*****************************************/
 
 /**************Definition***************************************************/
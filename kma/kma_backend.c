@@ -0,0 +1,311 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Dispatch of kma_malloc/kma_free to the selected backend
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_BACKEND_IMPL__
+
+/************System include***********************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_large.h"
+#include "kma_magazine.h"
+#include "kma_sample.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+kma_backend_t *kma_backends[] = {
+    &kma_dummy_backend,
+    &kma_rm_backend,
+    &kma_p2fl_backend,
+    &kma_mck2_backend,
+    &kma_bud_backend,
+    &kma_lzbud_backend,
+    &kma_slab_backend,
+    &kma_tlsf_backend,
+    &kma_bitmap_backend,
+    &kma_shard_backend,
+    &kma_hybrid_backend,
+#ifdef KMA_TEMPLATES
+    &kma_tmck2_backend,
+    &kma_tp2fl_backend,
+    &kma_tbud_backend,
+#endif
+    NULL
+};
+
+#ifdef KMA_MAGAZINE
+kma_backend_t *kma_current = &kma_magazine_backend;
+#else
+kma_backend_t *kma_current = &KMA_DEFAULT_BACKEND;
+#endif
+
+long kma_zero_avoided = 0;
+
+int kma_trims = 0;
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+/*
+ * Over the soft limit, kma_free() trims only once TRIM_BATCH bytes are
+ * cached, and then down to TRIM_BATCH below the limit, so that a trace
+ * hovering at the limit does not trim on every call. Pressure is read
+ * every PRESSURE_EVERY calls.
+ */
+#define TRIM_BATCH (16 * PAGESIZE)
+#define PRESSURE_EVERY 4096
+
+static long soft_limit = 0;
+static double pressure = -1;
+static int pressure_calls = 0;
+
+
+kma_backend_t *kma_backend_find(char *name) {
+    kma_backend_t **backend;
+
+    if (strncasecmp(name, "KMA_", 4) == 0) {
+        name += 4;
+    }
+    for (backend = kma_backends; *backend; backend++) {
+        if (strcasecmp(name, (*backend)->name) == 0) {
+            return *backend;
+        }
+    }
+    return NULL;
+}
+
+// requests past KMA_LARGE_MIN go to the large tier, whatever the backend
+static void *malloc_any(kma_size_t size) {
+    if (size > KMA_LARGE_MIN) {
+        kma_size_t dirty;
+        return kma_large_malloc(size, &dirty);
+    }
+    return kma_current->malloc(size);
+}
+
+void *kma_malloc(kma_size_t size) {
+    if (kma_sample_due(size)) {
+        return kma_sample_take(malloc_any(size), size);
+    }
+    return malloc_any(size);
+}
+
+// the share of time some task stalled on memory over the last 10
+// seconds, or -1 if the kernel does not tell
+static double stalled() {
+    FILE *f = fopen("/proc/pressure/memory", "r");
+    double avg10 = -1;
+    if (f) {
+        if (fscanf(f, "some avg10=%lf", &avg10) != 1) {
+            avg10 = -1;
+        }
+        fclose(f);
+    }
+    return avg10;
+}
+
+// what kma_limit() and kma_pressure() ask of a free; the page layer's
+// lock keeps other threads out of the counters it reads
+static void watch() {
+    pthread_mutex_lock(&kma_page_lock);
+    if (soft_limit && kma_held() > soft_limit) {
+        kma_page_stat_t *stat = page_stats();
+        if ((long) stat->num_cached * PAGESIZE + kma_large_cached >= TRIM_BATCH) {
+            kma_trim(soft_limit > TRIM_BATCH ? soft_limit - TRIM_BATCH : 0);
+        }
+    }
+    if (pressure >= 0 && ++pressure_calls == PRESSURE_EVERY) {
+        pressure_calls = 0;
+        if (stalled() >= pressure) {
+            kma_trim(0);
+        }
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+void kma_free(void *ptr, kma_size_t size) {
+    kma_sample_free(ptr);
+    if (size > KMA_LARGE_MIN) {
+        kma_large_free(ptr, size);
+    } else {
+        kma_current->free(ptr, size);
+    }
+    if (soft_limit || pressure >= 0) {
+        watch();
+    }
+}
+
+void *kma_calloc(kma_size_t size) {
+    kma_size_t dirty = size;
+    void *ptr;
+    if (size > KMA_LARGE_MIN) {
+        ptr = kma_sample_malloc(kma_large_malloc(size, &dirty), size);
+    } else if (kma_current->calloc) {
+        ptr = kma_sample_malloc(kma_current->calloc(size, &dirty), size);
+    } else {
+        ptr = kma_malloc(size);
+    }
+    if (ptr) {
+        memset(ptr, 0, dirty);
+        __atomic_fetch_add(&kma_zero_avoided, size - dirty, __ATOMIC_RELAXED);
+    }
+    return ptr;
+}
+
+void *kma_memalign(kma_size_t alignment, kma_size_t size) {
+    if (alignment <= 0 || (alignment & (alignment - 1)) || alignment > PAGESIZE) {
+        return NULL;
+    }
+    // large objects start on a page
+    if (size > KMA_LARGE_MIN) {
+        return kma_malloc(size);
+    }
+    if (kma_current->memalign) {
+        return kma_sample_malloc(kma_current->memalign(alignment, size), size);
+    }
+    // without the hook, only a block that happens to be aligned will do
+    void *ptr = kma_malloc(size);
+    if (ptr && ((long)ptr & (alignment - 1))) {
+        kma_free(ptr, size);
+        ptr = NULL;
+    }
+    return ptr;
+}
+
+int kma_malloc_batch(kma_size_t size, int n, void **out) {
+    int i;
+
+    if (kma_current->malloc_batch && size <= KMA_LARGE_MIN) {
+        n = kma_current->malloc_batch(size, n, out);
+        for (i = 0; i < n; i++) {
+            kma_sample_malloc(out[i], size);
+        }
+        return n;
+    }
+    for (i = 0; i < n && (out[i] = kma_malloc(size)); i++) {
+    }
+    return i;
+}
+
+static void free_small(void **ptrs, kma_size_t *sizes, int n) {
+    int i;
+
+    if (kma_current->free_batch) {
+        if (n) {
+            kma_current->free_batch(ptrs, sizes, n);
+        }
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        kma_current->free(ptrs[i], sizes[i]);
+    }
+}
+
+// large objects are freed one by one, between the runs of small ones
+void kma_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int start = 0, i;
+
+    if (kma_sample_live) {
+        for (i = 0; i < n; i++) {
+            kma_sample_free(ptrs[i]);
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (sizes[i] > KMA_LARGE_MIN) {
+            free_small(ptrs + start, sizes + start, i - start);
+            kma_large_free(ptrs[i], sizes[i]);
+            start = i + 1;
+        }
+    }
+    free_small(ptrs + start, sizes + start, n - start);
+    if (soft_limit || pressure >= 0) {
+        watch();
+    }
+}
+
+void *kma_malloc_hint(kma_size_t size, int lifetime) {
+    if (kma_current->malloc_hint && size <= KMA_LARGE_MIN) {
+        return kma_sample_malloc(kma_current->malloc_hint(size, lifetime), size);
+    }
+    return kma_malloc(size);
+}
+
+void *kma_realloc(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (!ptr) {
+        return kma_malloc(new_size);
+    }
+    if (old_size > KMA_LARGE_MIN || new_size > KMA_LARGE_MIN) {
+        if (old_size > KMA_LARGE_MIN && kma_large_resize(ptr, old_size, new_size)) {
+            return ptr;
+        }
+    } else if (kma_current->resize && kma_current->resize(ptr, old_size, new_size)) {
+        return ptr;
+    }
+    void *space = kma_malloc(new_size);
+    if (space) {
+        memcpy(space, ptr, old_size < new_size ? old_size : new_size);
+        kma_free(ptr, old_size);
+    }
+    return space;
+}
+
+long kma_held() {
+    kma_page_stat_t *stat = page_stats();
+    return ((long) stat->num_in_use + stat->num_cached) * PAGESIZE + kma_large_mapped;
+}
+
+// blocks the backend caches go back first, so their pages are free to
+// be given back with the others
+long kma_trim(long target) {
+    pthread_mutex_lock(&kma_page_lock);
+    if (kma_current->flush) {
+        kma_current->flush();
+    }
+    kma_large_flush();
+    kma_page_stat_t *stat = page_stats();
+    long over = kma_held() - target;
+    if (over > 0) {
+        long pages = (over + PAGESIZE - 1) / PAGESIZE;
+        release_pages(pages < stat->num_cached ? stat->num_cached - pages : 0);
+    }
+    kma_trims++;
+    long held = kma_held();
+    pthread_mutex_unlock(&kma_page_lock);
+    return held;
+}
+
+void kma_limit(long bytes) {
+    soft_limit = bytes > 0 ? bytes : 0;
+}
+
+void kma_pressure(double avg10) {
+    pressure = avg10;
+    pressure_calls = 0;
+}
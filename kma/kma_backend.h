@@ -0,0 +1,155 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Table of allocator backends behind kma_malloc/kma_free
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_BACKEND_H__
+#define __KMA_BACKEND_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_BACKEND_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/*
+ * Every allocator is compiled into every binary and exports one of
+ * these; its globals and helpers stay static to its file. The hooks
+ * after free are optional and may be NULL:
+ *   flush        - give back whatever the backend caches, so that all
+ *                  unused pages are freed
+ *   size         - the usable size of an allocated block, read from the
+ *                  backend's metadata; freeing the block with it is valid
+ *   resize       - make an allocated block of old bytes hold new bytes
+ *                  without moving it, by taking free space that follows it
+ *                  or giving its tail back; TRUE if the block now has to
+ *                  be freed with new, FALSE if it was left untouched
+ *   calloc       - malloc that also sets *dirty to how many leading bytes
+ *                  of the block may not be zero; the rest are known to be,
+ *                  as the backend has not written them since the page was
+ *                  mapped
+ *   memalign     - malloc for a block that starts on a multiple of align,
+ *                  a power of two; free takes the block with the same size
+ *   malloc_batch - n mallocs of one size into out; the number made
+ *                  is returned, fewer than n only on failure
+ *   free_batch   - n frees; ptrs may be of different sizes and pages
+ *   malloc_hint  - malloc that places the block by its expected
+ *                  lifetime, one of the KMA_LIFE_XXX hints
+ *   save         - write the state of the backend to image with offsets
+ *                  from the pool for pointers, then forget it; the bytes
+ *                  written, or -1 if room is short or it cannot be saved
+ *                  now
+ *   restore      - take back a state save wrote, over the pool wherever
+ *                  it is mapped now; FALSE if the image is not one
+ */
+typedef struct kma_backend_t {
+    char *name;
+    void *(*malloc)(kma_size_t size);
+    void (*free)(void *ptr, kma_size_t size);
+    void (*flush)();
+    kma_size_t (*size)(void *ptr);
+    bool (*resize)(void *ptr, kma_size_t old_size, kma_size_t new_size);
+    void *(*calloc)(kma_size_t size, kma_size_t *dirty);
+    void *(*memalign)(kma_size_t align, kma_size_t size);
+    int (*malloc_batch)(kma_size_t size, int n, void **out);
+    void (*free_batch)(void **ptrs, kma_size_t *sizes, int n);
+    void *(*malloc_hint)(kma_size_t size, int lifetime);
+    long (*save)(void *image, long room);
+    bool (*restore)(void *image, long size);
+} kma_backend_t;
+
+// the backend kma_malloc starts with, chosen by the -DKMA_XXX build flag
+#if defined(KMA_RM)
+#define KMA_DEFAULT_BACKEND kma_rm_backend
+#elif defined(KMA_P2FL)
+#define KMA_DEFAULT_BACKEND kma_p2fl_backend
+#elif defined(KMA_MCK2)
+#define KMA_DEFAULT_BACKEND kma_mck2_backend
+#elif defined(KMA_BUD)
+#define KMA_DEFAULT_BACKEND kma_bud_backend
+#elif defined(KMA_LZBUD)
+#define KMA_DEFAULT_BACKEND kma_lzbud_backend
+#elif defined(KMA_SLAB)
+#define KMA_DEFAULT_BACKEND kma_slab_backend
+#elif defined(KMA_TLSF)
+#define KMA_DEFAULT_BACKEND kma_tlsf_backend
+#elif defined(KMA_BITMAP)
+#define KMA_DEFAULT_BACKEND kma_bitmap_backend
+#elif defined(KMA_SHARD)
+#define KMA_DEFAULT_BACKEND kma_shard_backend
+#elif defined(KMA_HYBRID)
+#define KMA_DEFAULT_BACKEND kma_hybrid_backend
+#else
+#define KMA_DEFAULT_BACKEND kma_dummy_backend
+#endif
+
+/************Global Variables*********************************************/
+
+extern kma_backend_t kma_dummy_backend;
+extern kma_backend_t kma_rm_backend;
+extern kma_backend_t kma_p2fl_backend;
+extern kma_backend_t kma_mck2_backend;
+extern kma_backend_t kma_bud_backend;
+extern kma_backend_t kma_lzbud_backend;
+extern kma_backend_t kma_slab_backend;
+extern kma_backend_t kma_tlsf_backend;
+extern kma_backend_t kma_bitmap_backend;
+extern kma_backend_t kma_shard_backend;
+extern kma_backend_t kma_hybrid_backend;
+#ifdef KMA_TEMPLATES
+// instantiations of kma_policy.h, from kma_templates.cc
+extern kma_backend_t kma_tmck2_backend;
+extern kma_backend_t kma_tp2fl_backend;
+extern kma_backend_t kma_tbud_backend;
+#endif
+
+// NULL-terminated list of all of the above
+EXTERN kma_backend_t *kma_backends[];
+
+// the backend kma_malloc and kma_free dispatch to
+EXTERN kma_backend_t *kma_current;
+
+// bytes kma_calloc did not clear because they were known to be zero
+EXTERN long kma_zero_avoided;
+
+// kma_trim() calls, including those of the soft limit and of pressure
+EXTERN int kma_trims;
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Finds a backend by name
+ * ---------------------------------------------------------------------
+ *    Purpose: Looks a backend up by its name ("mck2") or its build
+ *             flag ("KMA_MCK2")
+ *    Input: the name
+ *    Output: the backend or NULL if there is none by that name
+ ***********************************************************************/
+EXTERN kma_backend_t *kma_backend_find(char *name);
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_BACKEND_H__ */
@@ -0,0 +1,140 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Batched against single-call allocation benchmark
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#define BATCH 512
+
+/************Global Variables*********************************************/
+
+// sizes measured; each is allocated BATCH at a time
+static kma_size_t sizes[] = {16, 64, 256, 1024};
+
+static void *ptr[BATCH];
+static kma_size_t size[BATCH];
+
+/************Function Prototypes******************************************/
+void error(char *, char *);
+
+double now();
+
+double single(kma_size_t, int);
+
+double batched(kma_size_t, int);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    kma_backend_t **b;
+    int i, failed = 0;
+
+    if (rounds <= 0) {
+        printf("Usage: %s [rounds] [backend...]\n", argv[0]);
+        exit(0);
+    }
+
+    printf("%8s %6s %14s %14s %8s\n", "backend", "size", "single Mops/s", "batch Mops/s", "speedup");
+    for (b = kma_backends; *b; b++) {
+        if (argc > 2) {
+            for (i = 2; i < argc && kma_backend_find(argv[i]) != *b; i++) {
+            }
+            if (i == argc) {
+                continue;
+            }
+        }
+        kma_current = *b;
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            // keep the pool mapped; the page layer drops it when no page
+            // is in use
+            void *pin = kma_malloc(sizes[i]);
+            double one = single(sizes[i], rounds);
+            double many = batched(sizes[i], rounds);
+            kma_free(pin, sizes[i]);
+            printf("%8s %6ld %14.2f %14.2f %7.2fx\n", (*b)->name, sizes[i], one, many, many / one);
+        }
+        if ((*b)->flush) {
+            (*b)->flush();
+        }
+        if (page_stats()->num_in_use) {
+            printf("%8s: not all pages freed\n", (*b)->name);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mops/s of BATCH kma_malloc calls followed by BATCH kma_free calls
+double single(kma_size_t s, int rounds) {
+    int r, j;
+
+    double start = now();
+    for (r = 0; r < rounds; r++) {
+        for (j = 0; j < BATCH; j++) {
+            ptr[j] = kma_malloc(s);
+            if (!ptr[j]) {
+                error("kma_malloc failed", kma_current->name);
+            }
+        }
+        for (j = 0; j < BATCH; j++) {
+            kma_free(ptr[j], s);
+        }
+    }
+    return 2.0 * rounds * BATCH / (now() - start) / 1e6;
+}
+
+// the same, with one kma_malloc_batch and one kma_free_batch per round
+double batched(kma_size_t s, int rounds) {
+    int r, j;
+
+    for (j = 0; j < BATCH; j++) {
+        size[j] = s;
+    }
+    double start = now();
+    for (r = 0; r < rounds; r++) {
+        if (kma_malloc_batch(s, BATCH, ptr) != BATCH) {
+            error("kma_malloc_batch failed", kma_current->name);
+        }
+        kma_free_batch(ptr, size, BATCH);
+    }
+    return 2.0 * rounds * BATCH / (now() - start) / 1e6;
+}
@@ -0,0 +1,267 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Kernel memory allocator based on per-page occupancy
+ *             bitmaps
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+
+/************System include***********************************************/
+#include <assert.h>
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_sizeclass.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+/*
+ * Every page serves one size class. Which blocks are free is recorded
+ * only in the page's bitmap in page_stat (a set bit is a free block), so
+ * neither kma_malloc nor kma_free reads or writes the blocks themselves.
+ * The smallest class is 16 bytes, so a page has at most 512 blocks.
+ * Blocks are taken lowest first, so on a page that came fresh from the
+ * pool every block from clean on is still all zero.
+ */
+#define BM_WORDS (PAGESIZE / 16 / 64)
+
+typedef struct page_t {
+    unsigned long long bitmap[BM_WORDS];
+    kma_page_t *page;
+    kma_size_t idx;
+    kma_size_t block_size;
+    kma_size_t nblocks;
+    kma_size_t nfree;
+    kma_size_t clean;
+    unsigned long magic;
+    struct page_t *prev;
+    struct page_t *next;
+} page_t;
+
+static page_t page_stat[MAXPAGES];
+static page_t *partial[KMA_SC_NCLASSES] = {0};
+
+
+static void push_partial(page_t *pg) {
+    pg->prev = NULL;
+    pg->next = partial[pg->idx];
+    if (pg->next) {
+        pg->next->prev = pg;
+    }
+    partial[pg->idx] = pg;
+}
+
+
+static void unlink_partial(page_t *pg) {
+    if (pg->prev) {
+        pg->prev->next = pg->next;
+    } else {
+        partial[pg->idx] = pg->next;
+    }
+    if (pg->next) {
+        pg->next->prev = pg->prev;
+    }
+}
+
+
+// NULL when the pool is full, which the shim falls back from
+static page_t *new_page(kma_size_t idx) {
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    page_t *pg = page_stat + page_index(page->ptr);
+    pg->page = page;
+    pg->idx = idx;
+    pg->block_size = kma_sc_size[idx];
+    pg->nblocks = PAGESIZE / pg->block_size;
+    pg->nfree = pg->nblocks;
+    pg->clean = page->zero ? 0 : pg->nblocks;
+    // offset * magic >> 32 == offset / block_size for block offsets
+    pg->magic = (1UL << 32) / pg->block_size + 1;
+    kma_size_t i;
+    for (i = 0; i < BM_WORDS; i++) {
+        kma_size_t bits = pg->nblocks - i * 64;
+        pg->bitmap[i] = bits >= 64 ? ~0ULL : bits > 0 ? (1ULL << bits) - 1 : 0;
+    }
+    return pg;
+}
+
+
+static void *bitmap_calloc(kma_size_t size, kma_size_t *dirty) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    if (kma_sc_size[idx] > PAGESIZE / 2) {
+        page_t *pg = new_page(idx);
+        if (!pg) {
+            return NULL;
+        }
+        pg->nfree = 0;
+        *dirty = pg->page->zero ? 0 : size;
+        return pg->page->ptr;
+    }
+    page_t *pg = partial[idx];
+    if (!pg) {
+        if (!(pg = new_page(idx))) {
+            return NULL;
+        }
+        push_partial(pg);
+    }
+    kma_size_t i = 0;
+    while (!pg->bitmap[i]) {
+        i++;
+    }
+    kma_size_t bit = __builtin_ctzll(pg->bitmap[i]);
+    pg->bitmap[i] &= pg->bitmap[i] - 1;
+    if (!--pg->nfree) {
+        unlink_partial(pg);
+    }
+    kma_size_t n = i * 64 + bit;
+    if (n >= pg->clean) {
+        pg->clean = n + 1;
+        *dirty = 0;
+    } else {
+        *dirty = size;
+    }
+    return pg->page->ptr + n * pg->block_size;
+}
+
+static void *bitmap_malloc(kma_size_t size) {
+    kma_size_t dirty;
+    return bitmap_calloc(size, &dirty);
+}
+
+// a word of the bitmap at a time: its set bits are taken until the
+// batch is full, and the word is written back once
+static int bitmap_malloc_batch(kma_size_t size, int n, void **out) {
+    int got = 0;
+    if (size <= 0 || size > PAGESIZE) {
+        return 0;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    if (kma_sc_size[idx] > PAGESIZE / 2) {
+        while (got < n && (out[got] = bitmap_malloc(size))) {
+            got++;
+        }
+        return got;
+    }
+    while (got < n) {
+        page_t *pg = partial[idx];
+        if (!pg) {
+            if (!(pg = new_page(idx))) {
+                return got;
+            }
+            push_partial(pg);
+        }
+        kma_size_t i, last = -1;
+        for (i = 0; i < BM_WORDS && got < n && pg->nfree; i++) {
+            unsigned long long word = pg->bitmap[i];
+            while (word && got < n) {
+                last = i * 64 + __builtin_ctzll(word);
+                word &= word - 1;
+                out[got++] = pg->page->ptr + last * pg->block_size;
+                pg->nfree--;
+            }
+            pg->bitmap[i] = word;
+        }
+        if (last >= pg->clean) {
+            pg->clean = last + 1;
+        }
+        if (!pg->nfree) {
+            unlink_partial(pg);
+        }
+    }
+    return got;
+}
+
+// blocks of one page that follow each other are set in its bitmap with
+// a single count update
+static void bitmap_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int i = 0;
+    while (i < n) {
+        page_t *pg = page_stat + page_index(ptrs[i]);
+        if (pg->block_size > PAGESIZE / 2) {
+            free_page(pg->page);
+            i++;
+            continue;
+        }
+        kma_size_t was_full = !pg->nfree;
+        for (; i < n && page_stat + page_index(ptrs[i]) == pg; i++) {
+            unsigned long b = ((unsigned long)(ptrs[i] - BASEADDR(ptrs[i])) * pg->magic) >> 32;
+            assert(!(pg->bitmap[b >> 6] & (1ULL << (b & 63))));
+            pg->bitmap[b >> 6] |= 1ULL << (b & 63);
+            pg->nfree++;
+        }
+        if (pg->nfree == pg->nblocks) {
+            if (!was_full) {
+                unlink_partial(pg);
+            }
+            free_page(pg->page);
+        } else if (was_full) {
+            push_partial(pg);
+        }
+    }
+}
+
+static void bitmap_free(void *ptr, kma_size_t size) {
+    bitmap_free_batch(&ptr, &size, 1);
+}
+
+static kma_size_t bitmap_size(void *ptr) {
+    return page_stat[page_index(ptr)].block_size;
+}
+
+// in place while the new size maps to the block's own class
+static bool bitmap_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (new_size <= 0 || new_size > PAGESIZE) {
+        return FALSE;
+    }
+    return kma_sc_size[kma_sc_index(new_size)] == page_stat[page_index(ptr)].block_size;
+}
+
+// blocks lie back to back from the page start, so a class whose size
+// is a multiple of align aligns every block
+static void *bitmap_memalign(kma_size_t align, kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    return bitmap_malloc(kma_sc_size[kma_sc_index_aligned(size, align)]);
+}
+
+kma_backend_t kma_bitmap_backend = {
+    .name = "bitmap",
+    .malloc = bitmap_malloc,
+    .free = bitmap_free,
+    .size = bitmap_size,
+    .resize = bitmap_resize,
+    .calloc = bitmap_calloc,
+    .memalign = bitmap_memalign,
+    .malloc_batch = bitmap_malloc_batch,
+    .free_batch = bitmap_free_batch
+};
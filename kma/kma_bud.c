@@ -38,7 +38,6 @@ Project Group: NetID1, NetID2, NetID3
 
 ***************************************************************************/
 
-#ifdef KMA_BUD
 #define __KMA_IMPL__
 
 /************System include***********************************************/
@@ -48,6 +47,8 @@ Project Group: NetID1, NetID2, NetID3
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
+#include "kma_sizeclass.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -66,44 +67,29 @@ Project Group: NetID1, NetID2, NetID3
 
 #define MINPOWER 5
 #define FL_SIZE 8
-#define BM_SIZE (PAGESIZE >> MINPOWER) / (sizeof(kma_size_t) << 3)
+#define BM_SIZE (PAGESIZE >> MINPOWER) / (sizeof(bm_word_t) << 3)
 
+// the bitmap is handled 32 bits at a time, whatever kma_size_t is
+typedef unsigned int bm_word_t;
 
 typedef struct page_wrapper_t {
     void *free_list[FL_SIZE];
-    kma_size_t bitmap[BM_SIZE];
+    bm_word_t bitmap[BM_SIZE];
     kma_page_t *page;
     struct page_wrapper_t *next;
 } page_wrapper_t;
 
 
 
-page_wrapper_t *main_entry = NULL;
+static page_wrapper_t *main_entry = NULL;
 
-kma_size_t idx(size) {
-    return
-        size > 256
-            ? size > 512
-                ? size > 1024
-                    ? size > 2048
-                        ? size > 4096 ? 8 : 7
-                        : 6
-                    : 5
-                : 4
-            : size > 128
-                ? 3
-                : size > 64
-                    ? 2
-                    : size > 32 ? 1 : 0;
-}
-
-void set_bitmap(kma_size_t *bitmap, kma_size_t offset, kma_size_t length, kma_size_t value) {
+static void set_bitmap(bm_word_t *bitmap, kma_size_t offset, kma_size_t length, kma_size_t value) {
     kma_size_t i;
     kma_size_t s = offset >> 5;
     kma_size_t e = (offset + length - 1) >> 5;
-    kma_size_t sv = 0xFFFFFFFF >> (offset & 0x0000001F);
-    kma_size_t ev = 0xFFFFFFFF << (0x00000020 - ((offset + length) & 0x0000001F));
-    kma_size_t vv = 0xFFFFFFFF;
+    bm_word_t sv = 0xFFFFFFFF >> (offset & 0x0000001F);
+    bm_word_t ev = 0xFFFFFFFF << (0x00000020 - ((offset + length) & 0x0000001F));
+    bm_word_t vv = 0xFFFFFFFF;
     if (value) {
         if (s == e) {
             bitmap[s] |= (sv & ev);
@@ -130,7 +116,7 @@ void set_bitmap(kma_size_t *bitmap, kma_size_t offset, kma_size_t length, kma_si
     }
 }
 
-kma_size_t check_buddy(kma_size_t *bitmap, kma_size_t buddy_offset, kma_size_t bufsize) {
+static kma_size_t check_buddy(bm_word_t *bitmap, kma_size_t buddy_offset, kma_size_t bufsize) {
     kma_size_t i;
     for (i = buddy_offset; i < buddy_offset + bufsize; i++) {
         if (bitmap[i >> 5] & (0x80000000 >> (i & 0x0000001F))) {
@@ -140,7 +126,7 @@ kma_size_t check_buddy(kma_size_t *bitmap, kma_size_t buddy_offset, kma_size_t b
     return TRUE;
 }
 
-void merge_free(page_wrapper_t *pw, void *ptr, kma_size_t index) {
+static void merge_free(page_wrapper_t *pw, void *ptr, kma_size_t index) {
     kma_size_t i = index, j;
     kma_size_t offset = (ptr - pw->page->ptr) >> MINPOWER;
     kma_size_t buddy_offset = ((offset >> i) & 0x00000001) ? offset - (1 << i) : offset + (1 << i);
@@ -170,24 +156,24 @@ void merge_free(page_wrapper_t *pw, void *ptr, kma_size_t index) {
     pw->free_list[i] = pw->page->ptr + offset;
 }
 
-page_wrapper_t *init_large_page_wrapper() {
+static page_wrapper_t *init_large_page_wrapper() {
     kma_page_t *page = get_page();
     page_wrapper_t *pw = (page_wrapper_t *)page->ptr;
     memset(pw->free_list, 0, FL_SIZE * sizeof(void *));
-    //memset(pw->bitmap, 0xFFFFFFFF, BM_SIZE * sizeof(kma_size_t));
+    //memset(pw->bitmap, 0xFFFFFFFF, BM_SIZE * sizeof(bm_word_t));
     pw->page = page;
     pw->next = NULL;
     return pw;
 }
 
-page_wrapper_t *init_page_wrapper() {
+static page_wrapper_t *init_page_wrapper() {
     kma_page_t *page = get_page();
     page_wrapper_t *pw = (page_wrapper_t *)page->ptr;
     memset(pw->free_list, 0, FL_SIZE * sizeof(void *));
-    memset(pw->bitmap, 0, BM_SIZE * sizeof(kma_size_t));
+    memset(pw->bitmap, 0, BM_SIZE * sizeof(bm_word_t));
     pw->page = page;
     pw->next = NULL;
-    kma_size_t index = idx(sizeof(page_wrapper_t));
+    kma_size_t index = kma_sc_pow2_index(sizeof(page_wrapper_t), MINPOWER);
     set_bitmap(pw->bitmap, 0, 1 << index, 1);
     kma_size_t i = FL_SIZE;
     while (i-- > index) {
@@ -198,74 +184,82 @@ page_wrapper_t *init_page_wrapper() {
     return pw;
 }
 
-kma_size_t is_empty(kma_size_t *bitmap) {
+static kma_size_t is_empty(bm_word_t *bitmap) {
     kma_size_t i;
     for (i = 1; i < BM_SIZE; i++) {
         if (bitmap[i]) {
             return FALSE;
         }
     }
-    kma_size_t index = idx(sizeof(page_wrapper_t));
+    kma_size_t index = kma_sc_pow2_index(sizeof(page_wrapper_t), MINPOWER);
     if (bitmap[0] != ~(0xFFFFFFFF >> (1 << index))) {
         return FALSE;
     }
     return TRUE;
 }
 
-void* kma_malloc(kma_size_t size) {
+// split a free block of order from or up down to order index; the
+// block returned starts where the one split did, so it is aligned to
+// the order split
+static void *take_block(page_wrapper_t *pw, kma_size_t index, kma_size_t from) {
+    kma_size_t i;
+    for (i = from; i < FL_SIZE; i++) {
+        if (pw->free_list[i]) {
+            void *space = pw->free_list[i];
+            pw->free_list[i] = *((void **)pw->free_list[i]);
+            while (i-- > index) {
+                kma_size_t offset = 1 << (MINPOWER + i);
+                *((void **)(space + offset)) = pw->free_list[i];
+                pw->free_list[i] = space + offset;
+            }
+            set_bitmap(pw->bitmap, (space - pw->page->ptr) >> MINPOWER, 1 << index, 1);
+            return space;
+        }
+    }
+    return NULL;
+}
+
+static void *bud_alloc(kma_size_t size, kma_size_t from) {
     if (!main_entry) {
         main_entry = init_page_wrapper();
     }
-    if (size > PAGESIZE / 2) {
-        page_wrapper_t *pw = init_large_page_wrapper();
-        pw->next = main_entry;
-        main_entry = pw;
-        return pw->page->ptr + sizeof(page_wrapper_t);
-    }
     page_wrapper_t *pw_pre = NULL;
     page_wrapper_t *pw_cur = main_entry;
-    kma_size_t index = idx(size);
-    kma_size_t i;
+    kma_size_t index = kma_sc_pow2_index(size, MINPOWER);
+    if (from < index) {
+        from = index;
+    }
     while (pw_cur) {
-        for (i = index; i < FL_SIZE; i++) {
-            if (pw_cur->free_list[i]) {
-                void *space = pw_cur->free_list[i];
-                pw_cur->free_list[i] = *((void **)pw_cur->free_list[i]);
-                while (i-- > index) {
-                    kma_size_t offset = 1 << (MINPOWER + i);
-                    *((void **)(space + offset)) = pw_cur->free_list[i];
-                    pw_cur->free_list[i] = space + offset;
-                }
-                set_bitmap(pw_cur->bitmap, (space - pw_cur->page->ptr) >> MINPOWER, 1 << index, 1);
-                return space;
-            }
+        void *space = take_block(pw_cur, index, from);
+        if (space) {
+            return space;
         }
         pw_pre = pw_cur;
         pw_cur = pw_cur->next;
     }
     pw_cur = init_page_wrapper();
     pw_pre->next = pw_cur;
-    for (i = index; i < FL_SIZE; i++) {
-        if (pw_cur->free_list[i]) {
-            void *space = pw_cur->free_list[i];
-            pw_cur->free_list[i] = *((void **)pw_cur->free_list[i]);
-            while (i-- > index) {
-                kma_size_t offset = 1 << (MINPOWER + i);
-                *((void **)(space + offset)) = pw_cur->free_list[i];
-                pw_cur->free_list[i] = space + offset;
-            }
-            set_bitmap(pw_cur->bitmap, (space - pw_cur->page->ptr) >> MINPOWER, 1 << index, 1);
-            return space;
+    return take_block(pw_cur, index, from);
+}
+
+static void* bud_malloc(kma_size_t size) {
+    if (size > PAGESIZE / 2) {
+        if (!main_entry) {
+            main_entry = init_page_wrapper();
         }
+        page_wrapper_t *pw = init_large_page_wrapper();
+        pw->next = main_entry;
+        main_entry = pw;
+        return pw->page->ptr + sizeof(page_wrapper_t);
     }
-    return NULL;
+    return bud_alloc(size, 0);
 }
 
 
-void kma_free(void* ptr, kma_size_t size) {
+static void bud_free(void* ptr, kma_size_t size) {
     page_wrapper_t *pw_pre = NULL;
     page_wrapper_t *pw_cur = main_entry;
-    kma_size_t index = idx(size);
+    kma_size_t index = kma_sc_pow2_index(size, MINPOWER);
     while (pw_cur) {
         if (pw_cur->page->ptr <= ptr && ptr < pw_cur->page->ptr + pw_cur->page->size) {
             if (size > PAGESIZE / 2) {
@@ -294,4 +288,70 @@ void kma_free(void* ptr, kma_size_t size) {
     }
 }
 
-#endif // KMA_BUD
+// a block only grows into the buddies above it, while it stays aligned
+// to its new size; shrinking hands the upper halves to the free lists
+static bool bud_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (old_size > PAGESIZE / 2 || new_size > PAGESIZE / 2) {
+        return old_size > PAGESIZE / 2 && new_size > PAGESIZE / 2 && new_size <= PAGESIZE - sizeof(page_wrapper_t);
+    }
+    if (new_size <= 0) {
+        return FALSE;
+    }
+    page_wrapper_t *pw = BASEADDR(ptr);
+    kma_size_t from = kma_sc_pow2_index(old_size, MINPOWER);
+    kma_size_t to = kma_sc_pow2_index(new_size, MINPOWER);
+    kma_size_t offset = (ptr - pw->page->ptr) >> MINPOWER;
+    kma_size_t i;
+    if (to < from) {
+        set_bitmap(pw->bitmap, offset + (1 << to), (1 << from) - (1 << to), 0);
+        for (i = to; i < from; i++) {
+            void *half = ptr + (1 << (MINPOWER + i));
+            *((void **)half) = pw->free_list[i];
+            pw->free_list[i] = half;
+        }
+        return TRUE;
+    }
+    if (to == from) {
+        return TRUE;
+    }
+    if (offset & ((1 << to) - 1) || !check_buddy(pw->bitmap, offset + (1 << from), (1 << to) - (1 << from))) {
+        return FALSE;
+    }
+    void *end = ptr + (1 << (MINPOWER + to));
+    for (i = 0; i < to; i++) {
+        void **link = &pw->free_list[i];
+        while (*link) {
+            if (ptr < *link && *link < end) {
+                *link = *((void **)*link);
+            } else {
+                link = (void **)*link;
+            }
+        }
+    }
+    set_bitmap(pw->bitmap, offset, 1 << to, 1);
+    return TRUE;
+}
+
+// blocks are aligned to their own size; larger alignments split a
+// larger block, and a large block moves up behind the page header
+static void *bud_memalign(kma_size_t align, kma_size_t size) {
+    if (size <= 0) {
+        return NULL;
+    }
+    if (size > PAGESIZE / 2) {
+        kma_size_t offset = (sizeof(page_wrapper_t) + align - 1) & ~(align - 1);
+        if (offset + size > PAGESIZE) {
+            return NULL;
+        }
+        return BASEADDR(bud_malloc(size)) + offset;
+    }
+    return bud_alloc(size, kma_sc_pow2_index(align, MINPOWER));
+}
+
+kma_backend_t kma_bud_backend = {
+    .name = "bud",
+    .malloc = bud_malloc,
+    .free = bud_free,
+    .resize = bud_resize,
+    .memalign = bud_memalign
+};
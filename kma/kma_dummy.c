@@ -41,7 +41,6 @@
  
  ***************************************************************************/
 
-#ifdef KMA_DUMMY
 #define __KMA_IMPL__
 
 /************System include***********************************************/
@@ -51,6 +50,7 @@
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -67,7 +67,7 @@
 
 /**************Implementation***********************************************/
 
-void* kma_malloc(kma_size_t size) {
+static void* dummy_malloc(kma_size_t size) {
     kma_page_t* page;
     // get one page
     page = get_page();
@@ -90,10 +90,42 @@ void* kma_malloc(kma_size_t size) {
     return page->ptr + sizeof(kma_page_t*);
 }
 
-void kma_free(void* ptr, kma_size_t size) {
+static void dummy_free(void* ptr, kma_size_t size) {
     kma_page_t* page;
     page = *((kma_page_t**)(ptr - sizeof(kma_page_t*)));
     free_page(page);
 }
 
-#endif // KMA_DUMMY
+// a block on a fresh page is all zero, only the page pointer is written
+static void* dummy_calloc(kma_size_t size, kma_size_t *dirty) {
+    void *ptr = dummy_malloc(size);
+    if (ptr) {
+        *dirty = (*((kma_page_t**)(ptr - sizeof(kma_page_t*))))->zero ? 0 : size;
+    }
+    return ptr;
+}
+
+// every block has a page to itself
+static bool dummy_resize(void* ptr, kma_size_t old_size, kma_size_t new_size) {
+    return new_size > 0 && ptr + new_size <= BASEADDR(ptr) + PAGESIZE;
+}
+
+// the block moves up to the alignment, the page pointer stays in front
+static void* dummy_memalign(kma_size_t align, kma_size_t size) {
+    kma_size_t offset = align > sizeof(kma_page_t*) ? align : sizeof(kma_page_t*);
+    if (size <= 0 || offset + size > PAGESIZE) {
+        return NULL;
+    }
+    kma_page_t* page = get_page();
+    *((kma_page_t**)(page->ptr + offset - sizeof(kma_page_t*))) = page;
+    return page->ptr + offset;
+}
+
+kma_backend_t kma_dummy_backend = {
+    .name = "dummy",
+    .malloc = dummy_malloc,
+    .free = dummy_free,
+    .resize = dummy_resize,
+    .calloc = dummy_calloc,
+    .memalign = dummy_memalign
+};
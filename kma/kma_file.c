@@ -0,0 +1,209 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: A page pool kept in a file, which a later run maps again
+ *             with the blocks and free lists as they were
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_FILE_IMPL__
+
+/************System include***********************************************/
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_file.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * The file is META_PAGES pages of header and images followed by the
+ * pool, and is mapped whole, shared, so the pool pages are the file's.
+ * While it is open the images are stale: kma_file_close() writes the
+ * page layer's and the backend's, and marks the file closed, which
+ * kma_file_reopen() requires. A run that ends without closing the file
+ * leaves one that cannot be reopened.
+ */
+#define MAGIC "KMAHEAP"
+#define VERSION 1
+#define META_PAGES 64
+#define META_SIZE ((long) META_PAGES * PAGESIZE)
+#define FILE_SIZE (META_SIZE + (long) MAXPAGES * PAGESIZE)
+
+typedef struct file_header_t {
+    char magic[8];
+    int version;
+    int page_size;
+    int max_pages;
+    int closed;
+    char backend[32];
+    kma_offset_t root;
+    long pages_at; // the page layer image, from the start of the file
+    long pages_size;
+    long backend_at; // the backend image
+    long backend_size;
+} file_header_t;
+
+static int fd = -1;
+static void *map = NULL;
+static file_header_t *header = NULL;
+
+
+
+// the file mapped on a page boundary: an anonymous reservation a page
+// longer is made, and the file mapped over its aligned part
+static void *map_file() {
+    void *area = mmap(NULL, FILE_SIZE + PAGESIZE, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        return NULL;
+    }
+    void *base = BASEADDR(area + PAGESIZE - 1);
+    if (mmap(base, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(area, FILE_SIZE + PAGESIZE);
+        return NULL;
+    }
+    if (base > area) {
+        munmap(area, base - area);
+    }
+    munmap(base + FILE_SIZE, area + PAGESIZE - base);
+    return base;
+}
+
+
+// gives up the file, and the pool with it if it was one
+static bool drop(bool pool) {
+    if (pool) {
+        use_pool(NULL);
+    }
+    if (map) {
+        munmap(map, FILE_SIZE);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = -1;
+    map = NULL;
+    header = NULL;
+    return FALSE;
+}
+
+
+bool kma_file_create(char *path) {
+    if (map || kma_pool || !kma_current->save || !kma_current->restore
+        || strlen(kma_current->name) >= sizeof(header->backend)) {
+        return FALSE;
+    }
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        return FALSE;
+    }
+    // the pool part of the file stays a hole until a page is written
+    if (ftruncate(fd, FILE_SIZE) < 0 || !(map = map_file())) {
+        return drop(FALSE);
+    }
+    header = map;
+    memcpy(header->magic, MAGIC, sizeof(header->magic));
+    header->version = VERSION;
+    header->page_size = PAGESIZE;
+    header->max_pages = MAXPAGES;
+    header->closed = 0;
+    strcpy(header->backend, kma_current->name);
+    header->root = 0;
+    use_pool(map + META_SIZE);
+    return TRUE;
+}
+
+
+bool kma_file_reopen(char *path) {
+    struct stat st;
+
+    if (map || kma_pool || !kma_current->restore) {
+        return FALSE;
+    }
+    if ((fd = open(path, O_RDWR)) < 0) {
+        return FALSE;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size != FILE_SIZE || !(map = map_file())) {
+        return drop(FALSE);
+    }
+    header = map;
+    if (memcmp(header->magic, MAGIC, sizeof(header->magic)) || header->version != VERSION
+        || header->page_size != PAGESIZE || header->max_pages != MAXPAGES || !header->closed
+        || strncmp(header->backend, kma_current->name, sizeof(header->backend))) {
+        return drop(FALSE);
+    }
+    use_pool(map + META_SIZE);
+    if (!load_pages(map + header->pages_at, header->pages_size)
+        || !kma_current->restore(map + header->backend_at, header->backend_size)) {
+        return drop(TRUE);
+    }
+    header->closed = 0;
+    return TRUE;
+}
+
+
+bool kma_file_close() {
+    if (!map) {
+        return FALSE;
+    }
+    long pages_at = ROUNDUP((long) sizeof(file_header_t), 64);
+    long pages_size = save_pages(map + pages_at, META_SIZE - pages_at);
+    if (pages_size < 0) {
+        return FALSE;
+    }
+    // the backend forgets its state once saved, so it goes last
+    long backend_at = ROUNDUP(pages_at + pages_size, 64);
+    long backend_size = kma_current->save(map + backend_at, META_SIZE - backend_at);
+    if (backend_size < 0) {
+        return FALSE;
+    }
+    header->pages_at = pages_at;
+    header->pages_size = pages_size;
+    header->backend_at = backend_at;
+    header->backend_size = backend_size;
+    header->closed = 1;
+    msync(map, FILE_SIZE, MS_SYNC);
+    drop(TRUE);
+    return TRUE;
+}
+
+
+void kma_file_set_root(void *ptr) {
+    if (header) {
+        header->root = kma_file_offset(ptr);
+    }
+}
+
+
+void *kma_file_root() {
+    return header ? kma_file_pointer(header->root) : NULL;
+}
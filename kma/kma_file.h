@@ -0,0 +1,117 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: A page pool kept in a file, which a later run maps again
+ *             with the blocks and free lists as they were
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_FILE_H__
+#define __KMA_FILE_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+#include "kma_page.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_FILE_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/*
+ * The pool may be mapped at another address each time the file is, so
+ * what is kept in blocks to find other blocks has to be an offset from
+ * the pool rather than a pointer: kma_file_offset() and
+ * kma_file_pointer() convert between the two, with 0 for NULL.
+ */
+typedef long kma_offset_t;
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Creates a heap file
+ * ---------------------------------------------------------------------
+ *    Purpose: Makes path, replacing what is there, a file for a pool of
+ *             MAXPAGES pages and maps it as the pool. Only while no
+ *             page is in use, and for a backend with save and restore
+ *    Input: the path
+ *    Output: TRUE if the pool is now the file, FALSE otherwise
+ ***********************************************************************/
+EXTERN bool kma_file_create(char *path);
+
+/***********************************************************************
+ *  Title: Reopens a heap file
+ * ---------------------------------------------------------------------
+ *    Purpose: Maps a file kma_file_close() left as the pool, possibly at
+ *             another address, and takes back the page layer and the
+ *             backend state kept there. Only while no page is in use,
+ *             for the backend that saved it
+ *    Input: the path
+ *    Output: TRUE if the heap is back, FALSE otherwise
+ ***********************************************************************/
+EXTERN bool kma_file_reopen(char *path);
+
+/***********************************************************************
+ *  Title: Closes the heap file
+ * ---------------------------------------------------------------------
+ *    Purpose: Saves the page layer and backend state to the file,
+ *             writes it out and unmaps it; the next page comes from an
+ *             anonymous pool again. Blocks of the large tier that are
+ *             not in pool pages are not part of the file
+ *    Input: none
+ *    Output: TRUE if it was closed, FALSE if the state could not be
+ *            saved, in which case it stays open
+ ***********************************************************************/
+EXTERN bool kma_file_close();
+
+/***********************************************************************
+ *  Title: Sets the root block
+ * ---------------------------------------------------------------------
+ *    Purpose: Keeps a block of the pool in the file as the one to start
+ *             from after kma_file_reopen()
+ *    Input: the block, or NULL
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_file_set_root(void *ptr);
+
+/***********************************************************************
+ *  Title: Gets the root block
+ * ---------------------------------------------------------------------
+ *    Purpose: Finds the block kma_file_set_root() last kept
+ *    Input: none
+ *    Output: the block where the pool is now, or NULL
+ ***********************************************************************/
+EXTERN void *kma_file_root();
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+static inline kma_offset_t kma_file_offset(void *ptr) {
+    return ptr ? ptr - kma_pool + 1 : 0;
+}
+
+static inline void *kma_file_pointer(kma_offset_t offset) {
+    return offset ? kma_pool + offset - 1 : NULL;
+}
+
+#endif /* __KMA_FILE_H__ */
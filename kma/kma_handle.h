@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Relocatable blocks reached through handles, which the
+ *             resource map may move to free sparse pages
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_HANDLE_H__
+#define __KMA_HANDLE_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_HANDLE_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+typedef int kma_handle_t;
+
+// no block; what kma_halloc() returns on failure
+#define KMA_NO_HANDLE 0
+
+/************Global Variables*********************************************/
+
+// blocks kma_compact() has moved, and the pages that freed
+EXTERN int kma_compact_moves;
+
+EXTERN int kma_compact_released;
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Allocates relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates size bytes on the resource map pages kept for
+ *             handles, apart from kma_malloc(). The block may move
+ *             whenever it is not pinned, so it is only reached through
+ *             kma_pin()
+ *    Input: the size
+ *    Output: the handle of the block or KMA_NO_HANDLE on failure
+ ***********************************************************************/
+EXTERN kma_handle_t kma_halloc(kma_size_t size);
+
+/***********************************************************************
+ *  Title: Frees relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Frees the block of a handle, pinned or not; the handle
+ *             may be given out again
+ *    Input: the handle
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_hfree(kma_handle_t);
+
+/***********************************************************************
+ *  Title: Resizes relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Like kma_realloc(), but the handle stays the same. A
+ *             pinned block is only resized in place
+ *    Input: the handle, the new size
+ *    Output: TRUE if the block now has the new size, FALSE if it was
+ *            left as it was
+ ***********************************************************************/
+EXTERN bool kma_hrealloc(kma_handle_t, kma_size_t new_size);
+
+/***********************************************************************
+ *  Title: Pins relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Keeps the block of a handle where it is until as many
+ *             kma_unpin() calls as kma_pin() calls have been made
+ *    Input: the handle
+ *    Output: the block, valid while it is pinned
+ ***********************************************************************/
+EXTERN void *kma_pin(kma_handle_t);
+
+/***********************************************************************
+ *  Title: Unpins relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Undoes one kma_pin(); pointers to the block must not be
+ *             used once it is no longer pinned
+ *    Input: the handle
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_unpin(kma_handle_t);
+
+/***********************************************************************
+ *  Title: Compacts relocatable kernel memory
+ * ---------------------------------------------------------------------
+ *    Purpose: Moves up to moves unpinned blocks off the sparsest page
+ *             without a pinned block into the other handle pages,
+ *             freeing each page it empties. Called a few moves at a
+ *             time it compacts incrementally
+ *    Input: the most blocks to move
+ *    Output: the number of pages freed
+ ***********************************************************************/
+EXTERN int kma_compact(int moves);
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_HANDLE_H__ */
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Heap instances, each with its own pages, that are released
+ *             as a whole
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_HEAP_IMPL__
+
+/************System include***********************************************/
+#include <string.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_heap.h"
+#include "kma_sizeclass.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * A heap hands out blocks of its size classes by bumping a pointer
+ * through its newest page, and a block freed before the heap is
+ * destroyed waits on the heap's free list of its class. Nothing on a
+ * page says which blocks are in use, so destroying the heap is one
+ * free_page() per page. The pages of a heap are chained off the page
+ * in page_stat, newest first; the oldest holds the heap itself and is
+ * freed last.
+ */
+typedef struct page_t {
+    kma_page_t *page;
+    struct page_t *next;
+} page_t;
+
+struct kma_heap_t {
+    page_t *pages;
+    void *next;
+    void *end;
+    void *free[KMA_SC_NCLASSES];
+};
+
+static page_t page_stat[MAXPAGES];
+
+
+
+// takes a page for the heap and chains it in front of its others
+static page_t *add_page(kma_heap_t *heap, kma_page_t *page) {
+    page_t *pg = page_stat + page_index(page->ptr);
+    pg->page = page;
+    pg->next = heap ? heap->pages : NULL;
+    return pg;
+}
+
+
+kma_heap_t *kma_heap_create() {
+    // NULL when the pool is full
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    kma_heap_t *heap = page->ptr;
+
+    memset(heap, 0, sizeof(kma_heap_t));
+    heap->pages = add_page(NULL, page);
+    heap->next = page->ptr + ROUNDUP(sizeof(kma_heap_t), 1 << KMA_SC_LG_QUANTUM);
+    heap->end = page->ptr + page->size;
+    return heap;
+}
+
+
+void *kma_heap_malloc(kma_heap_t *heap, kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    kma_size_t bufsize = kma_sc_size[idx];
+    void *ptr = heap->free[idx];
+    if (ptr) {
+        heap->free[idx] = *((void **)ptr);
+        return ptr;
+    }
+    // the rest of the newest page is given up once a block does not fit;
+    // with the pool full the heap keeps its pages and stays usable
+    if (heap->end - heap->next < bufsize) {
+        kma_page_t *page = get_pages(1);
+        if (!page) {
+            return NULL;
+        }
+        heap->pages = add_page(heap, page);
+        heap->next = page->ptr;
+        heap->end = page->ptr + page->size;
+    }
+    ptr = heap->next;
+    heap->next += bufsize;
+    return ptr;
+}
+
+
+void kma_heap_free(kma_heap_t *heap, void *ptr, kma_size_t size) {
+    kma_size_t idx = kma_sc_index(size);
+    *((void **)ptr) = heap->free[idx];
+    heap->free[idx] = ptr;
+}
+
+
+void kma_heap_destroy(kma_heap_t *heap) {
+    page_t *pg = heap->pages;
+    while (pg) {
+        page_t *next = pg->next;
+        free_page(pg->page);
+        pg = next;
+    }
+}
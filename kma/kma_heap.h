@@ -0,0 +1,87 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Heap instances that are released as a whole
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_HEAP_H__
+#define __KMA_HEAP_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_HEAP_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+typedef struct kma_heap_t kma_heap_t;
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Creates a heap
+ * ---------------------------------------------------------------------
+ *    Purpose: Creates a heap that takes its own pages from the page
+ *             layer, apart from kma_malloc() and every other heap. A
+ *             heap is used by one thread at a time
+ *    Input: none
+ *    Output: the heap or NULL on failure
+ ***********************************************************************/
+EXTERN kma_heap_t *kma_heap_create();
+
+/***********************************************************************
+ *  Title: Allocates memory from a heap
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates size bytes from the pages of the heap
+ *    Input: the heap, the size
+ *    Output: the allocated memory or NULL on failure
+ ***********************************************************************/
+EXTERN void *kma_heap_malloc(kma_heap_t *, kma_size_t size);
+
+/***********************************************************************
+ *  Title: Frees memory of a heap
+ * ---------------------------------------------------------------------
+ *    Purpose: Gives a block back to its heap before the heap is
+ *             destroyed, for later kma_heap_malloc() calls of its size
+ *             class; its page stays with the heap
+ *    Input: the heap, the pointer, the size
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_heap_free(kma_heap_t *, void *ptr, kma_size_t size);
+
+/***********************************************************************
+ *  Title: Destroys a heap
+ * ---------------------------------------------------------------------
+ *    Purpose: Returns every page of the heap to the page layer, which
+ *             frees all blocks still allocated from it at once
+ *    Input: the heap
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_heap_destroy(kma_heap_t *);
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_HEAP_H__ */
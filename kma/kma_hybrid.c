@@ -0,0 +1,318 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Kernel memory allocator that routes each size range to the
+ *             backend that wastes the least on it
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_HYBRID_IMPL__
+
+/************System include***********************************************/
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_hybrid.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+int kma_hybrid_reroutes = 0;
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#ifdef KMA_HYBRID_TABLE
+#include KMA_HYBRID_TABLE
+#else
+// what make hybridtable writes for testsuite/5.trace
+static kma_hybrid_route_t kma_hybrid_table[KMA_HYBRID_NBUCKETS] = {
+    { "shard", 3.03, "mck2", 3.03 },
+    { "mck2", 1.63, "shard", 1.63 },
+    { "rm", 1.37, "mck2", 1.44 },
+    { "rm", 0.89, "tlsf", 1.20 },
+    { "rm", 0.82, "tlsf", 0.97 },
+    { "rm", 0.63, "tlsf", 0.72 },
+    { "tlsf", 0.56, "rm", 0.54 },
+    { "rm", 0.39, "tlsf", 0.43 },
+    { "tlsf", 0.28, "rm", 0.31 },
+    { "dummy", 0.40, "shard", 0.40 }
+};
+#endif
+
+/*
+ * Every backend keeps its metadata per page, so several of them can
+ * share the page layer. A block goes back to the backend that owns its
+ * page, which the size of a later free need not route to once a bucket
+ * has been moved. Pages a backend takes or gives back during a call are
+ * charged to it, and every EPOCH allocations the waste ratio of each
+ * backend is checked against the profile of the buckets routed to it:
+ * past DRIFT times that (at least FLOOR), the bucket of the backend
+ * with the most live bytes moves to its alternate, once.
+ */
+#define EPOCH 1024
+#define DRIFT 2.0
+#define FLOOR 0.25
+#define MIN_LIVE (4 * PAGESIZE)
+#define MAX_ENGINES 16
+
+static kma_backend_t *engine[MAX_ENGINES];
+static int n_engines = 0;
+
+static unsigned char owner[MAXPAGES];
+static long engine_live[MAX_ENGINES];
+static int engine_pages[MAX_ENGINES];
+
+static int route[KMA_HYBRID_NBUCKETS];
+static int alternate[KMA_HYBRID_NBUCKETS];
+static double waste[KMA_HYBRID_NBUCKETS];
+static double alternate_waste[KMA_HYBRID_NBUCKETS];
+static long bucket_live[KMA_HYBRID_NBUCKETS];
+static int mallocs = 0;
+
+
+
+// the engine slot of the backend by that name, -1 if there is none
+static int engine_index(char *name) {
+    kma_backend_t *backend = name ? kma_backend_find(name) : NULL;
+    int i;
+    if (!backend || backend == &kma_hybrid_backend) {
+        return -1;
+    }
+    for (i = 0; i < n_engines; i++) {
+        if (engine[i] == backend) {
+            return i;
+        }
+    }
+    engine[n_engines] = backend;
+    return n_engines++;
+}
+
+
+static void init() {
+    int b;
+    for (b = 0; b < KMA_HYBRID_NBUCKETS; b++) {
+        route[b] = engine_index(kma_hybrid_table[b].engine);
+        if (route[b] < 0) {
+            route[b] = engine_index("mck2");
+        }
+        alternate[b] = engine_index(kma_hybrid_table[b].alternate);
+        waste[b] = kma_hybrid_table[b].waste;
+        alternate_waste[b] = kma_hybrid_table[b].alternate_waste;
+    }
+}
+
+
+static void adapt() {
+    int i, b;
+    for (i = 0; i < n_engines; i++) {
+        long live = engine_live[i];
+        double expected = FLOOR;
+        int move = -1;
+        if (live < MIN_LIVE) {
+            continue;
+        }
+        for (b = 0; b < KMA_HYBRID_NBUCKETS; b++) {
+            if (route[b] != i || waste[b] < 0) {
+                continue;
+            }
+            if (waste[b] > expected) {
+                expected = waste[b];
+            }
+            if (alternate[b] >= 0 && (move < 0 || bucket_live[b] > bucket_live[move])) {
+                move = b;
+            }
+        }
+        double ratio = (double)((long)engine_pages[i] * PAGESIZE - live) / live;
+        if (move >= 0 && ratio > DRIFT * expected) {
+            route[move] = alternate[move];
+            waste[move] = alternate_waste[move];
+            alternate[move] = -1;
+            kma_hybrid_reroutes++;
+        }
+    }
+}
+
+
+// the engine a request of that size goes to now
+static int pick(kma_size_t size) {
+    if (!n_engines) {
+        init();
+    }
+    if (++mallocs == EPOCH) {
+        mallocs = 0;
+        adapt();
+    }
+    return route[kma_hybrid_bucket(size)];
+}
+
+
+// charges engine i with the pages in use now beyond pages
+static void charge(int i, int pages) {
+    engine_pages[i] += page_stats()->num_in_use - pages;
+}
+
+
+// the bookkeeping for a block engine i has handed out
+static void *own(int i, void *ptr, kma_size_t size) {
+    if (ptr) {
+        owner[page_index(ptr)] = i;
+        engine_live[i] += size;
+        bucket_live[kma_hybrid_bucket(size)] += size;
+    }
+    return ptr;
+}
+
+
+static void* hybrid_calloc(kma_size_t size, kma_size_t *dirty) {
+    int i = pick(size);
+    int pages = page_stats()->num_in_use;
+    void *ptr;
+    if (engine[i]->calloc) {
+        ptr = engine[i]->calloc(size, dirty);
+    } else {
+        *dirty = size;
+        ptr = engine[i]->malloc(size);
+    }
+    charge(i, pages);
+    return own(i, ptr, size);
+}
+
+
+static void* hybrid_malloc(kma_size_t size) {
+    int i = pick(size);
+    int pages = page_stats()->num_in_use;
+    void *ptr = engine[i]->malloc(size);
+    charge(i, pages);
+    return own(i, ptr, size);
+}
+
+
+static void* hybrid_malloc_hint(kma_size_t size, int lifetime) {
+    int i = pick(size);
+    int pages = page_stats()->num_in_use;
+    void *ptr = engine[i]->malloc_hint ? engine[i]->malloc_hint(size, lifetime) : engine[i]->malloc(size);
+    charge(i, pages);
+    return own(i, ptr, size);
+}
+
+
+static void *hybrid_memalign(kma_size_t align, kma_size_t size) {
+    int i = pick(size);
+    int pages = page_stats()->num_in_use;
+    void *ptr;
+    if (engine[i]->memalign) {
+        ptr = engine[i]->memalign(align, size);
+    } else if ((ptr = engine[i]->malloc(size)) && ((long)ptr & (align - 1))) {
+        engine[i]->free(ptr, size);
+        ptr = NULL;
+    }
+    charge(i, pages);
+    return own(i, ptr, size);
+}
+
+
+static int hybrid_malloc_batch(kma_size_t size, int n, void **out) {
+    int i = pick(size);
+    int pages = page_stats()->num_in_use;
+    int got, j;
+    if (engine[i]->malloc_batch) {
+        got = engine[i]->malloc_batch(size, n, out);
+    } else {
+        for (got = 0; got < n && (out[got] = engine[i]->malloc(size)); got++) {
+        }
+    }
+    charge(i, pages);
+    for (j = 0; j < got; j++) {
+        own(i, out[j], size);
+    }
+    return got;
+}
+
+
+// blocks of one owner that follow each other are freed together
+static void hybrid_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int start = 0, j;
+    while (start < n) {
+        int i = owner[page_index(ptrs[start])];
+        int pages = page_stats()->num_in_use;
+        int end = start;
+        for (; end < n && owner[page_index(ptrs[end])] == i; end++) {
+            engine_live[i] -= sizes[end];
+            bucket_live[kma_hybrid_bucket(sizes[end])] -= sizes[end];
+        }
+        if (engine[i]->free_batch) {
+            engine[i]->free_batch(ptrs + start, sizes + start, end - start);
+        } else {
+            for (j = start; j < end; j++) {
+                engine[i]->free(ptrs[j], sizes[j]);
+            }
+        }
+        charge(i, pages);
+        start = end;
+    }
+}
+
+
+static void hybrid_free(void* ptr, kma_size_t size) {
+    hybrid_free_batch(&ptr, &size, 1);
+}
+
+
+// in place only within the owner, which is where it is freed
+static bool hybrid_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    int i = owner[page_index(ptr)];
+    int pages = page_stats()->num_in_use;
+    if (!engine[i]->resize || !engine[i]->resize(ptr, old_size, new_size)) {
+        return FALSE;
+    }
+    charge(i, pages);
+    engine_live[i] += new_size - old_size;
+    bucket_live[kma_hybrid_bucket(old_size)] -= old_size;
+    bucket_live[kma_hybrid_bucket(new_size)] += new_size;
+    return TRUE;
+}
+
+
+static void hybrid_flush() {
+    int i;
+    for (i = 0; i < n_engines; i++) {
+        int pages = page_stats()->num_in_use;
+        if (engine[i]->flush) {
+            engine[i]->flush();
+        }
+        charge(i, pages);
+    }
+}
+
+kma_backend_t kma_hybrid_backend = {
+    .name = "hybrid",
+    .malloc = hybrid_malloc,
+    .free = hybrid_free,
+    .flush = hybrid_flush,
+    .resize = hybrid_resize,
+    .calloc = hybrid_calloc,
+    .memalign = hybrid_memalign,
+    .malloc_batch = hybrid_malloc_batch,
+    .free_batch = hybrid_free_batch,
+    .malloc_hint = hybrid_malloc_hint
+};
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Routing of size ranges to backends for KMA_HYBRID
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_HYBRID_H__
+#define __KMA_HYBRID_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+#include "kma_sizeclass.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_HYBRID_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/*
+ * Requests are routed by power-of-two size bucket: bucket 0 holds sizes
+ * up to 16 bytes, bucket i those up to 16 << i, the last one those up
+ * to PAGESIZE. A routing table, written by kma_profile and swapped in
+ * with -DKMA_HYBRID_TABLE='"header"', gives each bucket the backend with
+ * the least waste on the profiled trace, the runner-up, and the average
+ * waste ratio each had there (-1 where the bucket saw no requests).
+ */
+#define KMA_HYBRID_LG_MIN 4
+#define KMA_HYBRID_NBUCKETS 10
+
+typedef struct {
+    char *engine;
+    double waste;
+    char *alternate;
+    double alternate_waste;
+} kma_hybrid_route_t;
+
+static inline kma_size_t kma_hybrid_bucket(kma_size_t size) {
+    kma_size_t bucket = kma_sc_pow2_index(size, KMA_HYBRID_LG_MIN);
+
+    return bucket < KMA_HYBRID_NBUCKETS ? bucket : KMA_HYBRID_NBUCKETS - 1;
+}
+
+/************Global Variables*********************************************/
+
+// buckets KMA_HYBRID moved to their alternate because the waste of
+// their backend drifted from what the profile measured
+EXTERN int kma_hybrid_reroutes;
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_HYBRID_H__ */
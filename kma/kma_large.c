@@ -0,0 +1,222 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Large objects of more than a page, in page runs or in
+ *             mappings of their own
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_LARGE_IMPL__
+
+/************System include***********************************************/
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_large.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+int kma_large_runs = 0;
+
+int kma_large_maps = 0;
+
+int kma_large_hits = 0;
+
+long kma_large_mapped = 0;
+
+long kma_large_cached = 0;
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * A run is freed through the descriptor of its first page. A mapping
+ * is a whole number of pages and needs no header, as its length
+ * follows from the size it is freed with. Up to CACHE_SLOTS freed
+ * mappings of at most CACHE_MAX bytes together wait in cache, newest
+ * last, for a request that needs no more than their length and not
+ * less than half of it, which gets the mapping cut to its own length;
+ * the oldest is unmapped to make room.
+ */
+#define CACHE_SLOTS 8
+#define CACHE_MAX (256 * PAGESIZE * CACHE_SLOTS)
+
+typedef struct mapping_t {
+    void *ptr;
+    kma_size_t length;
+} mapping_t;
+
+static mapping_t cache[CACHE_SLOTS];
+static int cached = 0;
+
+
+
+// the bytes a mapping of an object of size takes
+static kma_size_t map_length(kma_size_t size) {
+    return ROUNDUP(size, PAGESIZE);
+}
+
+
+// a new mapping of length bytes on a page boundary: one more page is
+// mapped, and what lies outside the aligned length is unmapped again
+static void *map(kma_size_t length) {
+    void *area = mmap(NULL, length + PAGESIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        return NULL;
+    }
+    void *ptr = BASEADDR(area + PAGESIZE - 1);
+    if (ptr > area) {
+        munmap(area, ptr - area);
+    }
+    munmap(ptr + length, area + PAGESIZE - ptr);
+    kma_large_mapped += length;
+    return ptr;
+}
+
+
+static void unmap(void *ptr, kma_size_t length) {
+    munmap(ptr, length);
+    kma_large_mapped -= length;
+}
+
+
+static void uncache(int i) {
+    kma_large_cached -= cache[i].length;
+    cached--;
+    for (; i < cached; i++) {
+        cache[i] = cache[i + 1];
+    }
+}
+
+
+static void *large_malloc(kma_size_t size, kma_size_t *dirty) {
+    if (size <= KMA_LARGE_RUN && page_stats()->num_in_use < KMA_LARGE_POOL) {
+        kma_page_t *page = get_pages(ROUNDUP(size, PAGESIZE) / PAGESIZE);
+        if (page) {
+            kma_large_runs++;
+            *dirty = page->zero ? 0 : size;
+            return page->ptr;
+        }
+    }
+    kma_size_t length = map_length(size);
+    int i;
+    for (i = cached - 1; i >= 0; i--) {
+        if (cache[i].length >= length && cache[i].length / 2 <= length) {
+            void *ptr = cache[i].ptr;
+            if (cache[i].length > length) {
+                unmap(ptr + length, cache[i].length - length);
+            }
+            uncache(i);
+            kma_large_hits++;
+            *dirty = size;
+            return ptr;
+        }
+    }
+    void *ptr = map(length);
+    if (ptr) {
+        kma_large_maps++;
+        *dirty = 0;
+    }
+    return ptr;
+}
+
+
+static void large_free(void *ptr, kma_size_t size) {
+    if (page_contains(ptr)) {
+        free_page(page_of(ptr));
+        return;
+    }
+    kma_size_t length = map_length(size);
+    if (length > CACHE_MAX) {
+        unmap(ptr, length);
+        return;
+    }
+    while (cached == CACHE_SLOTS || kma_large_cached + length > CACHE_MAX) {
+        unmap(cache[0].ptr, cache[0].length);
+        uncache(0);
+    }
+    cache[cached].ptr = ptr;
+    cache[cached].length = length;
+    kma_large_cached += length;
+    cached++;
+}
+
+
+// in place within its pages; a mapping also shrinks by unmapping its
+// tail
+static bool large_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (page_contains(ptr)) {
+        return new_size <= page_of(ptr)->size;
+    }
+    kma_size_t from = map_length(old_size);
+    kma_size_t to = map_length(new_size);
+    if (to < from) {
+        unmap(ptr + to, from - to);
+    }
+    return to <= from;
+}
+
+
+// the calls from outside take kma_page_lock, as runs come from the
+// page layer and other threads may be in it
+void *kma_large_malloc(kma_size_t size, kma_size_t *dirty) {
+    if (size <= KMA_LARGE_MIN) {
+        return NULL;
+    }
+    pthread_mutex_lock(&kma_page_lock);
+    void *ptr = large_malloc(size, dirty);
+    pthread_mutex_unlock(&kma_page_lock);
+    return ptr;
+}
+
+
+void kma_large_free(void *ptr, kma_size_t size) {
+    pthread_mutex_lock(&kma_page_lock);
+    large_free(ptr, size);
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+bool kma_large_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (new_size <= KMA_LARGE_MIN) {
+        return FALSE;
+    }
+    pthread_mutex_lock(&kma_page_lock);
+    bool done = large_resize(ptr, old_size, new_size);
+    pthread_mutex_unlock(&kma_page_lock);
+    return done;
+}
+
+
+void kma_large_flush() {
+    pthread_mutex_lock(&kma_page_lock);
+    while (cached) {
+        unmap(cache[0].ptr, cache[0].length);
+        uncache(0);
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+}
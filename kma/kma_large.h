@@ -0,0 +1,112 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Large objects of more than a page, in page runs or in
+ *             mappings of their own
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_LARGE_H__
+#define __KMA_LARGE_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+#include "kma_page.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_LARGE_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/*
+ * kma_malloc() and the others hand requests of more than KMA_LARGE_MIN
+ * bytes to the large tier instead of the backend. Objects of up to
+ * KMA_LARGE_RUN bytes take a run of pool pages while fewer than
+ * KMA_LARGE_POOL pages are in use, so that the rest is left to the
+ * backends, which have nowhere else to go; larger ones, and those the
+ * pool has no run for, get a mapping of their own. Every large object
+ * starts on a page boundary.
+ */
+#define KMA_LARGE_MIN PAGESIZE
+#define KMA_LARGE_RUN (32 * PAGESIZE)
+#define KMA_LARGE_POOL (MAXPAGES / 2)
+
+/************Global Variables*********************************************/
+
+// objects given page runs and mappings, the mappings that came from
+// the cache instead of mmap, and the bytes mapped now, cache included,
+// and in the cache
+EXTERN int kma_large_runs;
+
+EXTERN int kma_large_maps;
+
+EXTERN int kma_large_hits;
+
+EXTERN long kma_large_mapped;
+
+EXTERN long kma_large_cached;
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Allocates a large object
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates size bytes, more than KMA_LARGE_MIN, page
+ *             aligned; dirty is set to how many of them may not be
+ *             zero
+ *    Input: the size, where to put the dirty bytes
+ *    Output: the object or NULL on failure
+ ***********************************************************************/
+EXTERN void *kma_large_malloc(kma_size_t size, kma_size_t *dirty);
+
+/***********************************************************************
+ *  Title: Frees a large object
+ * ---------------------------------------------------------------------
+ *    Purpose: Gives a run back to the pool; keeps a mapping in the
+ *             cache of recently freed ones while there is room
+ *    Input: the object, its size
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_large_free(void *ptr, kma_size_t size);
+
+/***********************************************************************
+ *  Title: Resizes a large object
+ * ---------------------------------------------------------------------
+ *    Purpose: Makes a large object hold new_size bytes, also more than
+ *             KMA_LARGE_MIN, where it is
+ *    Input: the object, its size, the new size
+ *    Output: TRUE if it was resized in place, FALSE otherwise
+ ***********************************************************************/
+EXTERN bool kma_large_resize(void *ptr, kma_size_t old_size, kma_size_t new_size);
+
+/***********************************************************************
+ *  Title: Empties the mapping cache
+ * ---------------------------------------------------------------------
+ *    Purpose: Unmaps the mappings kept for reuse
+ *    Input: none
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_large_flush();
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_LARGE_H__ */
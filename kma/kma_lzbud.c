@@ -41,7 +41,6 @@
  
  ***************************************************************************/
 
-#ifdef KMA_LZBUD
 #define __KMA_IMPL__
 
 /************System include***********************************************/
@@ -51,6 +50,7 @@
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -67,12 +67,16 @@
 
 /**************Implementation***********************************************/
 
-void* kma_malloc(kma_size_t size) {
+static void* lzbud_malloc(kma_size_t size) {
   return NULL;
 }
 
-void kma_free(void* ptr, kma_size_t size) {
+static void lzbud_free(void* ptr, kma_size_t size) {
   ;
 }
 
-#endif // KMA_LZBUD
+kma_backend_t kma_lzbud_backend = {
+    .name = "lzbud",
+    .malloc = lzbud_malloc,
+    .free = lzbud_free
+};
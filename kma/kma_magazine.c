@@ -0,0 +1,408 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Per-thread magazine caching in front of any allocator
+ *             (Bonwick's magazines and depot)
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_MAGAZINE_IMPL__
+
+/************System include***********************************************/
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_magazine.h"
+#include "kma_sizeclass.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+// rounds per magazine; 0 sends every request to the locked backend
+#ifndef KMA_MAG_ROUNDS
+#define KMA_MAG_ROUNDS 16
+#endif
+
+#define MAXTHREADS 64
+
+/*
+ * Each thread holds a loaded and a previous magazine per size class and
+ * serves kma_malloc/kma_free from them without a lock. Only when both
+ * are empty (or both full) does it swap a magazine with the depot of
+ * that class, under the depot lock. Objects are taken from the backend
+ * at their class size, so any cached object can be handed out for any
+ * request of that class and returned to the backend with the class
+ * size. Requests above PAGESIZE / 2 go straight to the backend.
+ *
+ * The backends are not thread safe: every call into the wrapped one is
+ * made with kma_page_lock held, which also keeps the large tier out of
+ * the page layer meanwhile. Magazines are allocated from it too.
+ *
+ * A flush may come from any thread, through kma_trim() or a soft limit,
+ * while the others are in their magazines. It empties those of the
+ * calling thread and the depot, and bumps flush_gen; every other thread
+ * empties its own when it next finds its gen behind.
+ */
+typedef struct magazine_t {
+    kma_size_t rounds;
+    struct magazine_t *next;
+    void *obj[KMA_MAG_ROUNDS];
+} magazine_t;
+
+typedef struct depot_t {
+    pthread_mutex_t lock;
+    magazine_t *full;
+    magazine_t *empty;
+} depot_t;
+
+typedef struct thread_cache_t {
+    kma_size_t in_use;
+    int gen;
+    magazine_t *loaded[KMA_SC_NCLASSES];
+    magazine_t *previous[KMA_SC_NCLASSES];
+} thread_cache_t;
+
+static depot_t depot[KMA_SC_NCLASSES];
+static thread_cache_t thread_cache[MAXTHREADS];
+static int thread_count = 0;
+static int flush_gen = 0;
+static __thread thread_cache_t *my_cache = NULL;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t depot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static kma_backend_t *inner = &KMA_DEFAULT_BACKEND;
+
+
+static void cache_release(void *);
+
+static void depot_init() {
+    kma_size_t idx;
+    for (idx = 0; idx < KMA_SC_NCLASSES; idx++) {
+        pthread_mutex_init(&depot[idx].lock, NULL);
+    }
+    pthread_key_create(&cache_key, cache_release);
+}
+
+
+static void depot_put(depot_t *d, magazine_t *mag) {
+    pthread_mutex_lock(&d->lock);
+    if (mag->rounds) {
+        mag->next = d->full;
+        d->full = mag;
+    } else {
+        mag->next = d->empty;
+        d->empty = mag;
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+
+static void *backend_malloc(kma_size_t size) {
+    pthread_mutex_lock(&kma_page_lock);
+    void *ptr = inner->malloc(size);
+    pthread_mutex_unlock(&kma_page_lock);
+    return ptr;
+}
+
+
+static void backend_free(void *ptr, kma_size_t size) {
+    pthread_mutex_lock(&kma_page_lock);
+    inner->free(ptr, size);
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+static magazine_t *magazine_new() {
+    magazine_t *mag = backend_malloc(sizeof(magazine_t));
+    if (mag) {
+        mag->rounds = 0;
+        mag->next = NULL;
+    }
+    return mag;
+}
+
+
+// with kma_page_lock held: return the rounds and the magazine itself
+static void magazine_destroy(magazine_t *mag, kma_size_t idx) {
+    while (mag->rounds) {
+        inner->free(mag->obj[--mag->rounds], kma_sc_size[idx]);
+    }
+    inner->free(mag, sizeof(magazine_t));
+}
+
+
+// return the magazines of the calling thread, and their rounds
+static void cache_drain(thread_cache_t *tc) {
+    kma_size_t idx;
+    pthread_mutex_lock(&kma_page_lock);
+    for (idx = 0; idx < KMA_SC_NCLASSES; idx++) {
+        if (tc->loaded[idx]) {
+            magazine_destroy(tc->loaded[idx], idx);
+            magazine_destroy(tc->previous[idx], idx);
+            tc->loaded[idx] = NULL;
+            tc->previous[idx] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+// at thread exit: hand the magazines to the depot and free the slot
+static void cache_release(void *arg) {
+    thread_cache_t *tc = arg;
+    kma_size_t idx;
+    for (idx = 0; idx < KMA_SC_NCLASSES; idx++) {
+        if (tc->loaded[idx]) {
+            depot_put(depot + idx, tc->loaded[idx]);
+            depot_put(depot + idx, tc->previous[idx]);
+            tc->loaded[idx] = NULL;
+            tc->previous[idx] = NULL;
+        }
+    }
+    pthread_mutex_lock(&cache_lock);
+    tc->in_use = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+
+// the calling thread's cache with magazines for class idx, or NULL if
+// the backend has no room for them; the caller then goes to the backend
+static thread_cache_t *cache_get(kma_size_t idx) {
+    if (!my_cache) {
+        int i;
+        pthread_once(&depot_once, depot_init);
+        pthread_mutex_lock(&cache_lock);
+        for (i = 0; i < thread_count && thread_cache[i].in_use; i++) {
+        }
+        if (i == MAXTHREADS) {
+            error("too many threads for the magazine layer", "");
+        }
+        if (i == thread_count) {
+            thread_count++;
+        }
+        thread_cache[i].in_use = 1;
+        thread_cache[i].gen = __atomic_load_n(&flush_gen, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&cache_lock);
+        my_cache = thread_cache + i;
+        pthread_setspecific(cache_key, my_cache);
+    }
+    int gen = __atomic_load_n(&flush_gen, __ATOMIC_RELAXED);
+    if (my_cache->gen != gen) {
+        my_cache->gen = gen;
+        cache_drain(my_cache);
+    }
+    if (!my_cache->loaded[idx]) {
+        magazine_t *loaded = magazine_new();
+        magazine_t *previous = loaded ? magazine_new() : NULL;
+        if (!previous) {
+            if (loaded) {
+                backend_free(loaded, sizeof(magazine_t));
+            }
+            return NULL;
+        }
+        my_cache->loaded[idx] = loaded;
+        my_cache->previous[idx] = previous;
+    }
+    return my_cache;
+}
+
+
+static void *magazine_malloc(kma_size_t size) {
+    if (KMA_MAG_ROUNDS == 0 || size <= 0 || size > PAGESIZE / 2) {
+        return backend_malloc(size);
+    }
+    kma_size_t idx = kma_sc_index(size);
+    thread_cache_t *tc = cache_get(idx);
+    if (!tc) {
+        return backend_malloc(kma_sc_size[idx]);
+    }
+    magazine_t *mag = tc->loaded[idx];
+    if (mag->rounds) {
+        return mag->obj[--mag->rounds];
+    }
+    if (tc->previous[idx]->rounds) {
+        tc->loaded[idx] = tc->previous[idx];
+        tc->previous[idx] = mag;
+        mag = tc->loaded[idx];
+        return mag->obj[--mag->rounds];
+    }
+    depot_t *d = depot + idx;
+    pthread_mutex_lock(&d->lock);
+    if (d->full) {
+        magazine_t *full = d->full;
+        d->full = full->next;
+        tc->previous[idx]->next = d->empty;
+        d->empty = tc->previous[idx];
+        pthread_mutex_unlock(&d->lock);
+        tc->previous[idx] = mag;
+        tc->loaded[idx] = full;
+        return full->obj[--full->rounds];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return backend_malloc(kma_sc_size[idx]);
+}
+
+static void magazine_free(void *ptr, kma_size_t size) {
+    if (KMA_MAG_ROUNDS == 0 || size > PAGESIZE / 2) {
+        backend_free(ptr, size);
+        return;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    thread_cache_t *tc = cache_get(idx);
+    if (!tc) {
+        backend_free(ptr, kma_sc_size[idx]);
+        return;
+    }
+    magazine_t *mag = tc->loaded[idx];
+    if (mag->rounds < KMA_MAG_ROUNDS) {
+        mag->obj[mag->rounds++] = ptr;
+        return;
+    }
+    if (!tc->previous[idx]->rounds) {
+        tc->loaded[idx] = tc->previous[idx];
+        tc->previous[idx] = mag;
+        mag = tc->loaded[idx];
+        mag->obj[mag->rounds++] = ptr;
+        return;
+    }
+    depot_t *d = depot + idx;
+    pthread_mutex_lock(&d->lock);
+    magazine_t *empty = d->empty;
+    if (empty) {
+        d->empty = empty->next;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (!empty && !(empty = magazine_new())) {
+        backend_free(ptr, kma_sc_size[idx]);
+        return;
+    }
+    pthread_mutex_lock(&d->lock);
+    tc->previous[idx]->next = d->full;
+    d->full = tc->previous[idx];
+    pthread_mutex_unlock(&d->lock);
+    tc->previous[idx] = mag;
+    tc->loaded[idx] = empty;
+    empty->obj[empty->rounds++] = ptr;
+}
+
+// cached objects are whole classes; the rest are the backend's to resize
+static bool magazine_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    bool cached_old = KMA_MAG_ROUNDS > 0 && old_size <= PAGESIZE / 2;
+    bool cached_new = KMA_MAG_ROUNDS > 0 && new_size > 0 && new_size <= PAGESIZE / 2;
+    if (cached_old || cached_new) {
+        return cached_old && cached_new && kma_sc_index(old_size) == kma_sc_index(new_size);
+    }
+    bool done = FALSE;
+    pthread_mutex_lock(&kma_page_lock);
+    if (inner->resize) {
+        done = inner->resize(ptr, old_size, new_size);
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+    return done;
+}
+
+// take an object that happens to be aligned out of the magazine
+static void *magazine_take_aligned(magazine_t *mag, kma_size_t align) {
+    kma_size_t i;
+    for (i = mag->rounds - 1; i >= 0; i--) {
+        void *obj = mag->obj[i];
+        if (!((long)obj & (align - 1))) {
+            mag->obj[i] = mag->obj[--mag->rounds];
+            return obj;
+        }
+    }
+    return NULL;
+}
+
+// aligned blocks are freed into the cache like any other, so they are
+// taken from it too when one is there; otherwise the backend makes one
+// at the class size
+static void *magazine_memalign(kma_size_t align, kma_size_t size) {
+    if (!inner->memalign) {
+        return NULL;
+    }
+    if (KMA_MAG_ROUNDS > 0 && size > 0 && size <= PAGESIZE / 2) {
+        kma_size_t idx = kma_sc_index(size);
+        thread_cache_t *tc = cache_get(idx);
+        void *obj = tc ? magazine_take_aligned(tc->loaded[idx], align) : NULL;
+        if (!obj && tc) {
+            obj = magazine_take_aligned(tc->previous[idx], align);
+        }
+        if (obj) {
+            return obj;
+        }
+        size = kma_sc_size[idx];
+    }
+    pthread_mutex_lock(&kma_page_lock);
+    void *ptr = inner->memalign(align, size);
+    pthread_mutex_unlock(&kma_page_lock);
+    return ptr;
+}
+
+// the magazines of other threads are theirs to empty, on their next
+// call; those of exited threads are in the depot
+void kma_magazine_flush() {
+    kma_size_t idx;
+    pthread_once(&depot_once, depot_init);
+    pthread_mutex_lock(&kma_page_lock);
+    int gen = __atomic_add_fetch(&flush_gen, 1, __ATOMIC_RELAXED);
+    if (my_cache) {
+        my_cache->gen = gen;
+        cache_drain(my_cache);
+    }
+    for (idx = 0; idx < KMA_SC_NCLASSES; idx++) {
+        pthread_mutex_lock(&depot[idx].lock);
+        while (depot[idx].full) {
+            magazine_t *mag = depot[idx].full;
+            depot[idx].full = mag->next;
+            magazine_destroy(mag, idx);
+        }
+        while (depot[idx].empty) {
+            magazine_t *mag = depot[idx].empty;
+            depot[idx].empty = mag->next;
+            magazine_destroy(mag, idx);
+        }
+        pthread_mutex_unlock(&depot[idx].lock);
+    }
+    if (inner->flush) {
+        inner->flush();
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+void kma_magazine_wrap(kma_backend_t *backend) {
+    inner = backend;
+}
+
+kma_backend_t kma_magazine_backend = {
+    .name = "magazine",
+    .malloc = magazine_malloc,
+    .free = magazine_free,
+    .flush = kma_magazine_flush,
+    .resize = magazine_resize,
+    .memalign = magazine_memalign
+};
@@ -0,0 +1,71 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Interface of the per-thread magazine layer
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_MAGAZINE_H__
+#define __KMA_MAGAZINE_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+#include "kma_backend.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_MAGAZINE_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/************Global Variables*********************************************/
+
+// the magazine layer in front of the backend given to kma_magazine_wrap
+EXTERN kma_backend_t kma_magazine_backend;
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Sets the backend behind the magazines
+ * ---------------------------------------------------------------------
+ *    Purpose: Makes the magazine layer cache objects of the given
+ *             backend (by default the one of the -DKMA_XXX flag); only
+ *             while nothing is allocated through the magazines
+ *    Input: the backend, need not be thread safe
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_magazine_wrap(kma_backend_t *backend);
+
+/***********************************************************************
+ *  Title: Flushes all magazines
+ * ---------------------------------------------------------------------
+ *    Purpose: Returns the cached objects of the calling thread and of
+ *             the depot, and the magazines themselves, to the backend;
+ *             every other thread returns its own on its next call, so
+ *             it may be called while they allocate
+ *    Input: none
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_magazine_flush();
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_MAGAZINE_H__ */
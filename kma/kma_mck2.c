@@ -42,7 +42,6 @@
  
  ***************************************************************************/
 
-#ifdef KMA_MCK2
 #define __KMA_IMPL__
 
 /************System include***********************************************/
@@ -51,6 +50,8 @@
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
+#include "kma_sizeclass.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -67,146 +68,291 @@
 
 /**************Implementation***********************************************/
 
-#define MINPOWER 4
-#define FREELISTSIZE 9
-#if __x86_64__ || __ppc64__
-#define MASK 0xFFFFFFFFFFFFE000
-#else
-#define MASK 0xFFFFE000
-#endif
-
-
+/*
+ * Every page serves a single size class and threads its own free blocks,
+ * so releasing an empty page never touches another page's blocks. Pages
+ * with at least one free block sit on the partial list of their class;
+ * full pages are on no list at all. On a page that came fresh from the
+ * pool, blocks from clean on were never handed out, so only their free
+ * list link is not zero.
+ *
+ * Blocks hinted short-lived are bumped, whatever their class, through
+ * one nursery page at a time. A nursery page only counts its blocks and
+ * is freed as a whole once the last of them dies, so the long-lived
+ * blocks never pin it, and its holes are not reused before then.
+ */
 typedef struct page_t {
     kma_page_t *page;
-    kma_size_t block_size;
+    kma_size_t block_size; // 0 on a nursery page
     kma_size_t used_count;
+    kma_size_t idx;
+    void *freelist;
+    void *clean;
+    struct page_t *prev;
     struct page_t *next;
 } page_t;
 
-page_t page_stat[MAXPAGES];
-page_t *page_head = NULL;
-page_t *free_head = NULL;
-void *freelist[FREELISTSIZE] = {0};
-
-
-
-kma_size_t IDX(size) {
-    // not process size larger than 4096
-    return
-        size > 256
-            ? size > 512
-                ? size > 1024
-                    ? size > 2048 ? 8 : 7
-                    : 6
-                : 5
-            : size > 128
-                ? 4
-                : size > 64
-                    ? 3
-                    : size > 32
-                        ? 2
-                        : size > 16 ? 1 : 0;
+static page_t page_stat[MAXPAGES];
+static page_t *partial[KMA_SC_NCLASSES] = {0};
+
+// the nursery page being bumped through, and its next free byte
+static page_t *nursery = NULL;
+static void *nursery_next = NULL;
+
+
+
+static void push_partial(page_t *pg) {
+    pg->prev = NULL;
+    pg->next = partial[pg->idx];
+    if (pg->next) {
+        pg->next->prev = pg;
+    }
+    partial[pg->idx] = pg;
 }
 
 
-void inc_used(void* ptr) {
-    page_t *looper = page_head;
-    while (looper) {
-        if ((void *)((unsigned long)ptr & MASK) == looper->page->ptr) {
-            looper->used_count++;
-            return;
-        }
-        looper = looper->next;
+static void unlink_partial(page_t *pg) {
+    if (pg->prev) {
+        pg->prev->next = pg->next;
+    } else {
+        partial[pg->idx] = pg->next;
+    }
+    if (pg->next) {
+        pg->next->prev = pg->prev;
     }
 }
 
 
-void* kma_malloc(kma_size_t size) {
-    if (!free_head && !page_head) {
-        int i;
-        for (i = 0; i < MAXPAGES - 1; i++) {
-            (page_stat[i]).next = page_stat + i + 1;
-        }
-        (page_stat[MAXPAGES - 1]).next = NULL;
-        free_head = page_stat;
+// NULL when the pool is full, which the shim falls back from
+static page_t *new_page(kma_size_t block_size) {
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    page_t *pg = page_stat + page_index(page->ptr);
+    pg->page = page;
+    pg->block_size = block_size;
+    pg->used_count = 0;
+    pg->freelist = NULL;
+    pg->clean = page->zero ? page->ptr : page->ptr + page->size;
+    pg->prev = NULL;
+    pg->next = NULL;
+    return pg;
+}
+
+
+// a page of class idx whose first used blocks are handed out as a run;
+// the blocks after them are threaded and the page goes on the partial
+// list if there are any
+static page_t *new_class_page(kma_size_t idx, kma_size_t used) {
+    kma_size_t bufsize = kma_sc_size[idx];
+    page_t *pg = new_page(bufsize);
+    if (!pg) {
+        return NULL;
+    }
+    pg->idx = idx;
+    pg->used_count = used;
+    void *ptr = pg->page->ptr + used * bufsize;
+    if (pg->clean < ptr) {
+        pg->clean = ptr;
+    }
+    if (ptr + bufsize > pg->page->ptr + pg->page->size) {
+        return pg;
+    }
+    pg->freelist = ptr;
+    for (; ptr + 2 * bufsize <= pg->page->ptr + pg->page->size; ptr += bufsize) {
+        *((kma_link_t *)ptr) = kma_link(ptr + bufsize);
     }
-    void *space = NULL;
+    *((kma_link_t *)ptr) = kma_link(NULL);
+    push_partial(pg);
+    return pg;
+}
+
+static void* mck2_calloc(kma_size_t size, kma_size_t *dirty) {
     if (size > PAGESIZE / 2) {
-        kma_page_t *page = get_page();
-        page_t *tmp = free_head;
-        free_head = free_head->next;
-        tmp->page = page;
-        tmp->used_count = 1;
-        tmp->block_size = page->size;
-        tmp->next = page_head;
-        page_head = tmp;
-        space = page->ptr;
+        page_t *pg = new_page(PAGESIZE);
+        if (!pg) {
+            return NULL;
+        }
+        pg->used_count = 1;
+        *dirty = pg->page->zero ? 0 : size;
+        return pg->page->ptr;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    page_t *pg = partial[idx];
+    if (!pg && !(pg = new_class_page(idx, 0))) {
+        return NULL;
+    }
+    void *space = pg->freelist;
+    pg->freelist = kma_ptr(*((kma_link_t *)space));
+    pg->used_count++;
+    if (!pg->freelist) {
+        unlink_partial(pg);
+    }
+    if (space >= pg->clean) {
+        pg->clean = space + pg->block_size;
+        *dirty = size < sizeof(kma_link_t) ? size : sizeof(kma_link_t);
     } else {
-        kma_size_t idx = IDX(size);
-        kma_size_t bufsize = 1 << (MINPOWER + idx);
-        if (freelist[idx]) {
-            space = freelist[idx];
-            inc_used(freelist[idx]);
-            freelist[idx] = *((void **)freelist[idx]);
-        } else {
-            kma_page_t *page = get_page();
-            page_t *tmp = free_head;
-            free_head = free_head->next;
-            tmp->page = page;
-            tmp->used_count = 1;
-            tmp->block_size = bufsize;
-            tmp->next = page_head;
-            page_head = tmp;
+        *dirty = size;
+    }
+    return space;
+}
+
+static void* mck2_malloc(kma_size_t size) {
+    kma_size_t dirty;
+    return mck2_calloc(size, &dirty);
+}
+
+static void* mck2_malloc_hint(kma_size_t size, int lifetime) {
+    if (lifetime != KMA_LIFE_SHORT || size <= 0 || size > PAGESIZE / 2) {
+        return mck2_malloc(size);
+    }
+    kma_size_t bufsize = kma_sc_size[kma_sc_index(size)];
+    if (!nursery || nursery_next + bufsize > nursery->page->ptr + nursery->page->size) {
+        if (!(nursery = new_page(0))) {
+            return NULL;
+        }
+        nursery_next = nursery->page->ptr;
+    }
+    void *space = nursery_next;
+    nursery_next += bufsize;
+    nursery->used_count++;
+    return space;
+}
+
+// whole free lists are taken off partial pages, and a fresh page hands
+// out its leading blocks without threading them first
+static int mck2_malloc_batch(kma_size_t size, int n, void **out) {
+    int got = 0;
+    if (size <= 0 || size > PAGESIZE / 2) {
+        while (got < n && (out[got] = mck2_malloc(size))) {
+            got++;
+        }
+        return got;
+    }
+    kma_size_t idx = kma_sc_index(size);
+    kma_size_t bufsize = kma_sc_size[idx];
+    while (got < n) {
+        page_t *pg = partial[idx];
+        if (!pg) {
+            kma_size_t run = PAGESIZE / bufsize;
+            if (run > n - got) {
+                run = n - got;
+            }
+            if (!(pg = new_class_page(idx, run))) {
+                return got;
+            }
             void *ptr;
-            for (ptr = page->ptr + bufsize; ptr < page->ptr + page->size - bufsize; ptr += bufsize) {
-                *((void **)ptr) = ptr + bufsize;
+            for (ptr = pg->page->ptr; run--; ptr += bufsize) {
+                out[got++] = ptr;
+            }
+            continue;
+        }
+        void *space = pg->freelist;
+        kma_size_t taken = 0;
+        while (space && got < n) {
+            if (space >= pg->clean) {
+                pg->clean = space + bufsize;
             }
-            *((void **)(page->ptr + page->size - bufsize)) = freelist[idx];
-            freelist[idx] = page->ptr + bufsize;
-            space = page->ptr;
+            out[got++] = space;
+            space = kma_ptr(*((kma_link_t *)space));
+            taken++;
+        }
+        pg->freelist = space;
+        pg->used_count += taken;
+        if (!space) {
+            unlink_partial(pg);
         }
     }
-    return space;
+    return got;
 }
 
-void kma_free(void* ptr, kma_size_t size) {
-    page_t *looper = page_head;
-    page_t *looper_pre = NULL;
-    while (looper) {
-        if ((void *)((unsigned long)ptr & MASK) == looper->page->ptr) {
-            looper->used_count--;
-            if (looper->used_count) {
-                kma_size_t idx = IDX(looper->block_size);
-                *((void **)ptr) = freelist[idx];
-                freelist[idx] = ptr;
-            } else {
-                if (looper->block_size < looper->page->size) {
-                    kma_size_t idx = IDX(looper->block_size);
-                    void *block_looper = freelist[idx];
-                    freelist[idx] = NULL;
-                    while (block_looper) {
-                        void *tmp = block_looper;
-                        block_looper = *((void **)block_looper);
-                        if ((void *)((unsigned long)tmp & MASK) != looper->page->ptr) {
-                            *((void **)tmp) = freelist[idx];
-                            freelist[idx] = tmp;
-                        }
-                    }
-                }
-                free_page(looper->page);
-                if (looper != page_head) {
-                    looper_pre->next = looper->next;
-                } else {
-                    page_head = looper->next;
+// the blocks that follow each other on one page are chained first and
+// put on its free list with one count update
+static void mck2_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int i = 0;
+    while (i < n) {
+        page_t *pg = page_stat + page_index(ptrs[i]);
+        if (pg->block_size == pg->page->size) {
+            free_page(pg->page);
+            i++;
+            continue;
+        }
+        if (!pg->block_size) {
+            for (; i < n && page_stat + page_index(ptrs[i]) == pg; i++) {
+                pg->used_count--;
+            }
+            if (!pg->used_count) {
+                if (pg == nursery) {
+                    nursery = NULL;
                 }
-                looper->next = free_head;
-                free_head = looper;
+                free_page(pg->page);
+            }
+            continue;
+        }
+        kma_size_t was_full = !pg->freelist;
+        void *head = pg->freelist;
+        kma_size_t count = 0;
+        for (; i < n && page_stat + page_index(ptrs[i]) == pg; i++, count++) {
+            *((kma_link_t *)ptrs[i]) = kma_link(head);
+            head = ptrs[i];
+        }
+        pg->freelist = head;
+        pg->used_count -= count;
+        if (!pg->used_count) {
+            if (!was_full) {
+                unlink_partial(pg);
             }
-            return;
+            free_page(pg->page);
+        } else if (was_full) {
+            push_partial(pg);
         }
-        looper_pre = looper;
-        looper = looper->next;
     }
 }
 
-#endif // KMA_MCK2
+static void mck2_free(void* ptr, kma_size_t size) {
+    mck2_free_batch(&ptr, &size, 1);
+}
+
+// the size of a nursery block is not kept, so it reads as 0; only the
+// shim asks, and hinted blocks never come from it
+static kma_size_t mck2_size(void *ptr) {
+    return page_stat[page_index(ptr)].block_size;
+}
+
+// in place while the new size maps to the block's own class
+static bool mck2_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    kma_size_t block_size = page_stat[page_index(ptr)].block_size;
+    if (new_size <= 0 || new_size > PAGESIZE) {
+        return FALSE;
+    }
+    if (!block_size) {
+        block_size = kma_sc_size[kma_sc_index(old_size)];
+    }
+    if (new_size > PAGESIZE / 2) {
+        return block_size == PAGESIZE;
+    }
+    return kma_sc_size[kma_sc_index(new_size)] == block_size;
+}
+
+// blocks lie back to back from the page start, so a class whose size
+// is a multiple of align aligns every block
+static void *mck2_memalign(kma_size_t align, kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    return mck2_malloc(kma_sc_size[kma_sc_index_aligned(size, align)]);
+}
+
+kma_backend_t kma_mck2_backend = {
+    .name = "mck2",
+    .malloc = mck2_malloc,
+    .free = mck2_free,
+    .size = mck2_size,
+    .resize = mck2_resize,
+    .calloc = mck2_calloc,
+    .memalign = mck2_memalign,
+    .malloc_batch = mck2_malloc_batch,
+    .free_batch = mck2_free_batch,
+    .malloc_hint = mck2_malloc_hint
+};
@@ -0,0 +1,296 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Multi-threaded trace replay through the magazine layer
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_magazine.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+typedef struct op_t {
+    int id;
+    kma_size_t size;  // 0 for a free
+    bool resize;      // a REALLOC to size
+    bool zero;        // a CALLOC
+    kma_size_t align; // of an ALIGNED, 0 otherwise
+    int count;        // ids from id on, for a BATCH or BATCHFREE
+    int arena;        // of an ARENA or DESTROY, -1 otherwise
+} op_t;
+
+/************Global Variables*********************************************/
+
+// the parsed trace, shared read-only by all threads
+static op_t *ops;
+static int numOps = 0;
+static int numIds = 0;
+static int rounds = 1;
+
+// set to stop the thread that trims while the replays run
+static int trimmed = 0;
+
+/************Function Prototypes******************************************/
+void error(char *, char *);
+
+double now();
+
+void load(char *);
+
+void *replay(void *);
+
+void *trim(void *);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    int threads, maxThreads, trimming;
+    int i;
+    pthread_t trimmer;
+
+    if (argc < 2 || argc > 5) {
+        printf("Usage: %s traceFile [maxThreads] [rounds] [trim]\n", argv[0]);
+        exit(0);
+    }
+    maxThreads = argc > 2 ? atoi(argv[2]) : 4;
+    rounds = argc > 3 ? atoi(argv[3]) : 3;
+    // with trim, another thread calls kma_trim(0) throughout the timed
+    // replays, as a soft limit would from any thread
+    trimming = argc > 4 && atoi(argv[4]);
+    if (maxThreads <= 0 || rounds <= 0) {
+        error("bad thread or round count", "");
+    }
+    load(argv[1]);
+
+    // keep the pool mapped; the page layer drops it when no page is in use
+    void *pin = kma_malloc(16);
+
+    // fault in the pool and fill the caches before timing
+    pthread_t *thread = malloc(maxThreads * sizeof(pthread_t));
+    assert(thread != NULL);
+    for (i = 0; i < maxThreads; i++) {
+        pthread_create(&thread[i], NULL, replay, NULL);
+    }
+    for (i = 0; i < maxThreads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+
+    double base = 0;
+    if (trimming) {
+        pthread_create(&trimmer, NULL, trim, NULL);
+    }
+    printf("threads     Mops/s   speedup\n");
+    for (threads = 1; threads <= maxThreads; threads++) {
+        double start = now();
+        for (i = 0; i < threads; i++) {
+            pthread_create(&thread[i], NULL, replay, NULL);
+        }
+        for (i = 0; i < threads; i++) {
+            pthread_join(thread[i], NULL);
+        }
+        double mops = (double) threads * rounds * numOps / (now() - start) / 1e6;
+        if (threads == 1) {
+            base = mops;
+        }
+        printf("%7d %10.2f %8.2fx\n", threads, mops, mops / base);
+    }
+    if (trimming) {
+        __atomic_store_n(&trimmed, 1, __ATOMIC_RELAXED);
+        pthread_join(trimmer, NULL);
+        printf("Trims: %d\n", kma_trims);
+    }
+
+    free(thread);
+    kma_free(pin, 16);
+    kma_magazine_flush();
+    kma_page_stat_t *stat = page_stats();
+    printf("Page Requested/Freed/In Use: %5d/%5d/%5d\n", stat->num_requested, stat->num_freed, stat->num_in_use);
+    free(ops);
+    return stat->num_in_use != 0;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void load(char *file) {
+    FILE *f = fopen(file, "r");
+    char command[16];
+    int id, size, align, count, arena, capacity = 1024;
+
+    if (f == NULL) {
+        error("unable to open trace file", file);
+    }
+    if (fscanf(f, "%d", &numIds) != 1) {
+        error("missing request count in trace", file);
+    }
+    ops = malloc(capacity * sizeof(op_t));
+    assert(ops != NULL);
+    while (fscanf(f, "%15s", command) == 1) {
+        if (numOps == capacity) {
+            capacity *= 2;
+            ops = realloc(ops, capacity * sizeof(op_t));
+            assert(ops != NULL);
+        }
+        arena = -1;
+        if (strcmp(command, "REQUEST") == 0 || strcmp(command, "CALLOC") == 0) {
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                error("malformed REQUEST", file);
+            }
+            align = 0;
+            count = 0;
+        } else if (strcmp(command, "ALIGNED") == 0) {
+            if (fscanf(f, "%d %d %d", &id, &size, &align) != 3) {
+                error("malformed ALIGNED", file);
+            }
+            count = 0;
+        } else if (strcmp(command, "BATCH") == 0) {
+            if (fscanf(f, "%d %d %d", &id, &count, &size) != 3) {
+                error("malformed BATCH", file);
+            }
+            align = 0;
+        } else if (strcmp(command, "BATCHFREE") == 0) {
+            if (fscanf(f, "%d %d", &id, &count) != 2) {
+                error("malformed BATCHFREE", file);
+            }
+            size = 0;
+            align = 0;
+        } else if (strcmp(command, "ARENA") == 0) {
+            if (fscanf(f, "%d %d %d", &arena, &id, &size) != 3) {
+                error("malformed ARENA", file);
+            }
+            align = 0;
+            count = 0;
+        } else if (strcmp(command, "DESTROY") == 0) {
+            if (fscanf(f, "%d", &arena) != 1) {
+                error("malformed DESTROY", file);
+            }
+            id = 0;
+            size = 0;
+            align = 0;
+            count = 0;
+        } else if (strcmp(command, "FREE") == 0) {
+            if (fscanf(f, "%d", &id) != 1) {
+                error("malformed FREE", file);
+            }
+            size = 0;
+            align = 0;
+            count = 0;
+        } else if (strcmp(command, "REALLOC") == 0) {
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                error("malformed REALLOC", file);
+            }
+            align = 0;
+            count = 0;
+        } else {
+            error("unknown command in trace", command);
+        }
+        if (id < 0 || id + (count ? count : 1) > numIds) {
+            error("request id out of range", file);
+        }
+        ops[numOps].id = id;
+        ops[numOps].size = size;
+        ops[numOps].resize = strcmp(command, "REALLOC") == 0;
+        ops[numOps].zero = strcmp(command, "CALLOC") == 0;
+        ops[numOps].align = align;
+        ops[numOps].count = count;
+        ops[numOps].arena = arena;
+        numOps++;
+    }
+    fclose(f);
+}
+
+// each thread replays its own copy of the trace; the page layer under
+// the heaps is not locked, so an arena's blocks come from kma_malloc and
+// its DESTROY frees those still allocated one by one
+void *replay(void *arg) {
+    void **ptr = calloc(numIds, sizeof(void *));
+    kma_size_t *size = calloc(numIds, sizeof(kma_size_t));
+    int *arena = malloc(numIds * sizeof(int));
+    int r, i, j;
+
+    assert(ptr != NULL && size != NULL && arena != NULL);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < numOps; i++) {
+            op_t *op = ops + i;
+            if (op->arena >= 0 && !op->size) {
+                for (j = 0; j < numIds; j++) {
+                    if (ptr[j] && arena[j] == op->arena) {
+                        kma_free(ptr[j], size[j]);
+                        ptr[j] = NULL;
+                    }
+                }
+            } else if (op->resize) {
+                void *space = kma_realloc(ptr[op->id], size[op->id], op->size);
+                if (space) {
+                    ptr[op->id] = space;
+                    size[op->id] = op->size;
+                }
+            } else if (op->count && op->size) {
+                int n = kma_malloc_batch(op->size, op->count, ptr + op->id);
+                while (n--) {
+                    size[op->id + n] = op->size;
+                    arena[op->id + n] = -1;
+                }
+            } else if (op->count) {
+                kma_free_batch(ptr + op->id, size + op->id, op->count);
+                memset(ptr + op->id, 0, op->count * sizeof(void *));
+            } else if (op->align) {
+                ptr[op->id] = kma_memalign(op->align, op->size);
+                size[op->id] = op->size;
+                arena[op->id] = -1;
+            } else if (op->size) {
+                ptr[op->id] = op->zero ? kma_calloc(op->size) : kma_malloc(op->size);
+                size[op->id] = op->size;
+                arena[op->id] = op->arena;
+            } else if (ptr[op->id]) {
+                kma_free(ptr[op->id], size[op->id]);
+                ptr[op->id] = NULL;
+            }
+        }
+    }
+    free(ptr);
+    free(size);
+    free(arena);
+    return NULL;
+}
+
+void *trim(void *arg) {
+    while (!__atomic_load_n(&trimmed, __ATOMIC_RELAXED)) {
+        kma_trim(0);
+    }
+    return NULL;
+}
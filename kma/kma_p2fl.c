@@ -42,7 +42,6 @@
  
  ***************************************************************************/
 
-#ifdef KMA_P2FL
 #define __KMA_IMPL__
 
 /************System include***********************************************/
@@ -51,6 +50,8 @@
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
+#include "kma_sizeclass.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -85,21 +86,22 @@
  */
 
 #define PTRSIZE sizeof(void *)
-#define MINPOWER 4
-#define FREELISTSIZE 10
 
 typedef struct page_wrapper_t {
     kma_page_t *page;
     struct page_wrapper_t *next;
 } page_wrapper_t;
 
-page_wrapper_t page_stat[MAXPAGES];
-page_wrapper_t *page_head = NULL;
-page_wrapper_t *free_head = NULL;
-void *free_list[FREELISTSIZE] = {0};
+static page_wrapper_t page_stat[MAXPAGES];
+static page_wrapper_t *page_head = NULL;
+static page_wrapper_t *free_head = NULL;
+static void *free_list[KMA_SC_NCLASSES] = {0};
 
 
-void* kma_malloc(kma_size_t size) {
+// a fresh page for class idx; the blocks from the used-th on go onto
+// the class free list, the ones before are the caller's. NULL when the
+// pool is full, which the shim falls back from
+static void *new_class_page(kma_size_t idx, kma_size_t used) {
     if (!page_head && !free_head) {
         free_head = page_stat;
         (page_stat[MAXPAGES - 1]).next = NULL;
@@ -108,26 +110,31 @@ void* kma_malloc(kma_size_t size) {
             (page_stat[i]).next = page_stat + i + 1;
         }
     }
-    kma_size_t idx = 0;
-    kma_size_t bufsize = 1 << MINPOWER;
-    size += PTRSIZE;
-    while (bufsize < size) {
-        idx++;
-        bufsize <<= 1;
+    kma_size_t bufsize = kma_sc_size[idx];
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
     }
-    if (!free_list[idx]) {
-        kma_page_t *page = get_page();
-        page_wrapper_t *tmp = free_head;
-        free_head = free_head->next;
-        tmp->page = page;
-        tmp->next = page_head;
-        page_head = tmp;
-        void *ptr;
-        for (ptr = page->ptr; ptr < page->ptr + page->size - bufsize; ptr += bufsize) {
+    page_wrapper_t *tmp = free_head;
+    free_head = free_head->next;
+    tmp->page = page;
+    tmp->next = page_head;
+    page_head = tmp;
+    void *ptr = page->ptr + used * bufsize;
+    if (ptr + bufsize <= page->ptr + page->size) {
+        for (; ptr + 2 * bufsize <= page->ptr + page->size; ptr += bufsize) {
             *((void **)ptr) = ptr + bufsize;
         }
-        *((void **)(page->ptr + page->size - bufsize)) = free_list[idx];
-        free_list[idx] = page->ptr;
+        *((void **)ptr) = free_list[idx];
+        free_list[idx] = page->ptr + used * bufsize;
+    }
+    return page->ptr;
+}
+
+static void* p2fl_malloc(kma_size_t size) {
+    kma_size_t idx = kma_sc_index(size + PTRSIZE);
+    if (!free_list[idx] && !new_class_page(idx, 0)) {
+        return NULL;
     }
     void *space = free_list[idx];
     free_list[idx] = *((void **)free_list[idx]);
@@ -135,22 +142,32 @@ void* kma_malloc(kma_size_t size) {
     return space + PTRSIZE;
 }
 
-void kma_free(void* ptr, kma_size_t size) {
-    ptr -= PTRSIZE;
+// the start of the block ptr lies in: blocks fill a page back to back
+static void *block_start(void *ptr, kma_size_t idx) {
+    void *base = BASEADDR(ptr);
+    return base + (ptr - base) / kma_sc_size[idx] * kma_sc_size[idx];
+}
+
+// blocks are tagged with their class free list while in use
+static kma_size_t block_class(void *ptr) {
     kma_size_t idx = 0;
-    while (*((void **)ptr) != free_list + idx) {
+    while (*((void **)(ptr - PTRSIZE)) != free_list + idx) {
         idx++;
     }
-    *((void **)ptr) = free_list[idx];
-    free_list[idx] = ptr;
+    return idx;
+}
+
+// with the block at ptr just freed: if nothing on its page is in use
+// any more, take the page's blocks off the free list and release it
+static void release_if_empty(void *ptr, kma_size_t idx) {
     page_wrapper_t *page_cur = page_head;
     page_wrapper_t *page_pre = NULL;
     while (page_cur) {
         kma_page_t *page = page_cur->page;
         if (page->ptr <= ptr && ptr < page->ptr + page->size) {
-            kma_size_t bufsize = 1 << (idx + MINPOWER);
+            kma_size_t bufsize = kma_sc_size[idx];
             void *tmp;
-            for (tmp = page->ptr; tmp < page->ptr + page->size; tmp += bufsize) {
+            for (tmp = page->ptr; tmp + bufsize <= page->ptr + page->size; tmp += bufsize) {
                 if (*((void **)tmp) == free_list + idx) {
                     return;
                 }
@@ -180,4 +197,93 @@ void kma_free(void* ptr, kma_size_t size) {
     }
 }
 
-#endif // KMA_P2FL
+// a fresh page hands its leading blocks out as a run
+static int p2fl_malloc_batch(kma_size_t size, int n, void **out) {
+    kma_size_t idx = kma_sc_index(size + PTRSIZE);
+    kma_size_t bufsize = kma_sc_size[idx];
+    int got = 0;
+    while (got < n) {
+        void *space = free_list[idx];
+        if (!space) {
+            kma_size_t run = PAGESIZE / bufsize;
+            if (run > n - got) {
+                run = n - got;
+            }
+            if (!(space = new_class_page(idx, run))) {
+                return got;
+            }
+            for (; run--; space += bufsize) {
+                *((void **)space) = free_list + idx;
+                out[got++] = space + PTRSIZE;
+            }
+            continue;
+        }
+        free_list[idx] = *((void **)space);
+        *((void **)space) = free_list + idx;
+        out[got++] = space + PTRSIZE;
+    }
+    return got;
+}
+
+// whether a page became empty is checked once for each run of blocks
+// from that page, after the last of them is back on the free list
+static void p2fl_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        kma_size_t idx = block_class(ptrs[i]);
+        void *ptr = block_start(ptrs[i] - PTRSIZE, idx);
+        *((void **)ptr) = free_list[idx];
+        free_list[idx] = ptr;
+        if (i + 1 == n || BASEADDR(ptrs[i]) != BASEADDR(ptrs[i + 1])) {
+            release_if_empty(ptr, idx);
+        }
+    }
+}
+
+static void p2fl_free(void* ptr, kma_size_t size) {
+    p2fl_free_batch(&ptr, &size, 1);
+}
+
+static kma_size_t p2fl_size(void *ptr) {
+    kma_size_t idx = *((void ***)(ptr - PTRSIZE)) - free_list;
+    return block_start(ptr - PTRSIZE, idx) + kma_sc_size[idx] - ptr;
+}
+
+// in place while the new size maps to the block's own class
+static bool p2fl_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    void **head = *((void ***)(ptr - PTRSIZE));
+    if (new_size <= 0 || new_size > p2fl_size(ptr)) {
+        return FALSE;
+    }
+    return kma_sc_index(new_size + PTRSIZE) == head - free_list;
+}
+
+// the block is aligned by its class; the payload moves up by align, with
+// the class tag both at the block start and in front of the payload
+static void *p2fl_memalign(kma_size_t align, kma_size_t size) {
+    if (align <= PTRSIZE) {
+        return p2fl_malloc(size);
+    }
+    if (size <= 0 || size + align > PAGESIZE) {
+        return NULL;
+    }
+    kma_size_t idx = kma_sc_index_aligned(size + align, align);
+    void *block = p2fl_malloc(kma_sc_size[idx] - PTRSIZE);
+    if (!block) {
+        return NULL;
+    }
+    block -= PTRSIZE;
+    *((void **)(block + align - PTRSIZE)) = free_list + idx;
+    return block + align;
+}
+
+kma_backend_t kma_p2fl_backend = {
+    .name = "p2fl",
+    .malloc = p2fl_malloc,
+    .free = p2fl_free,
+    .size = p2fl_size,
+    .resize = p2fl_resize,
+    .memalign = p2fl_memalign,
+    .malloc_batch = p2fl_malloc_batch,
+    .free_batch = p2fl_free_batch
+};
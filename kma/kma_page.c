@@ -48,6 +48,7 @@
  ***************************************************************************/
 
 #define __KPAGE_IMPL__
+#define _GNU_SOURCE
 
 /************System include***********************************************/
 #include <assert.h>
@@ -55,6 +56,7 @@
 #include <string.h>
 #include <strings.h>
 #include <stdio.h>
+#include <sys/mman.h>
 
 /************Private include**********************************************/
 #include "kma_page.h"
@@ -68,15 +70,52 @@
  */
 
 /************Global Variables*********************************************/
-static kma_page_stat_t kma_page_stats = {0, 0, 0, PAGESIZE};
-
-static void *pool = NULL;
-static void *next_free_page = NULL;
+static kma_page_stat_t kma_page_stats = {0, 0, 0, PAGESIZE, 0};
+
+void *kma_pool = NULL;
+
+pthread_mutex_t kma_page_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+// freed pages, by index, most recently freed first; the links are kept
+// off the pages so that a run can take pages from the middle
+static int free_head = -1;
+static int free_next[MAXPAGES];
+static int free_prev[MAXPAGES];
+static char page_free[MAXPAGES];
+// what page_free holds: in use (or fresh), freed, and freed with its
+// memory given back by release_pages()
+#define IN_USE 0
+#define CACHED 1
+#define RELEASED 2
+// pages from this one on have never been handed out (nor touched)
+static int next_fresh = 0;
+static int next_id = 0;
+// the pool was given by use_pool(), so it stays mapped when empty
+static int given_pool = 0;
+
+// page descriptors, one per pool page; nothing here may call malloc,
+// so the allocators can stand in for it (see kma_shim.c)
+static kma_page_t page_table[MAXPAGES];
+
+// what save_pages() writes: the page layer without its pointers, which
+// load_pages() derives from the pool base
+typedef struct pages_image_t {
+    kma_page_stat_t stats;
+    int next_id;
+    int free_head;
+    int next_fresh;
+    int free_next[MAXPAGES];
+    int free_prev[MAXPAGES];
+    char page_free[MAXPAGES];
+    int id[MAXPAGES];
+    int size[MAXPAGES];
+    char zero[MAXPAGES];
+} pages_image_t;
 
 /************Function Prototypes******************************************/
-void *allocPage();
+int allocPages(int, int *);
 
-void freePage(void *);
+void freePages(int, int);
 
 void initPages();
 
@@ -85,18 +124,35 @@ void initPages();
 /**************Implementation***********************************************/
 
 kma_page_t *get_page() {
-    static int id = 0;
+    kma_page_t *res = get_pages(1);
+
+    if (res == NULL) {
+        error("error: all pages already allocated", "");
+    }
+
+    return res;
+}
+
+kma_page_t *get_pages(int n) {
     kma_page_t *res;
 
-    kma_page_stats.num_requested++;
-    kma_page_stats.num_in_use++;
+    assert(n > 0);
+
+    int zero;
+    int first = allocPages(n, &zero);
 
-    res = (kma_page_t *) malloc(sizeof(kma_page_t));
-    res->id = id++;
-    res->size = kma_page_stats.page_size;
-    res->ptr = allocPage();
+    if (first < 0) {
+        return NULL;
+    }
+
+    kma_page_stats.num_requested += n;
+    kma_page_stats.num_in_use += n;
 
-    assert(res->ptr != NULL);
+    res = page_table + first;
+    res->id = next_id++;
+    res->size = n * kma_page_stats.page_size;
+    res->ptr = kma_pool + first * PAGESIZE;
+    res->zero = zero;
 
     return res;
 }
@@ -104,13 +160,15 @@ kma_page_t *get_page() {
 void free_page(kma_page_t *ptr) {
     assert(ptr != NULL);
     assert(ptr->ptr != NULL);
-    assert(kma_page_stats.num_in_use > 0);
 
-    kma_page_stats.num_freed++;
-    kma_page_stats.num_in_use--;
+    int n = ptr->size / PAGESIZE;
+
+    assert(kma_page_stats.num_in_use >= n);
 
-    freePage(ptr->ptr);
-    free(ptr);
+    kma_page_stats.num_freed += n;
+    kma_page_stats.num_in_use -= n;
+
+    freePages(page_index(ptr->ptr), n);
 }
 
 kma_page_stat_t *page_stats() {
@@ -119,59 +177,195 @@ kma_page_stat_t *page_stats() {
     return memcpy(&stats, &kma_page_stats, sizeof(kma_page_stat_t));
 }
 
-void *allocPage() {
-    void *res;
+int page_index(void *ptr) {
+    assert(kma_pool != NULL);
+    assert(ptr >= kma_pool && ptr < kma_pool + MAXPAGES * PAGESIZE);
 
-    if (pool == NULL) {
-        initPages();
+    return (ptr - kma_pool) / PAGESIZE;
+}
+
+int page_contains(void *ptr) {
+    return kma_pool != NULL && ptr >= kma_pool && ptr < kma_pool + MAXPAGES * PAGESIZE;
+}
+
+kma_page_t *page_of(void *ptr) {
+    return page_table + page_index(ptr);
+}
+
+long release_pages(int keep) {
+    long released = 0;
+    int i;
+
+    for (i = free_head; i >= 0; i = free_next[i]) {
+        if (page_free[i] != CACHED || keep-- > 0) {
+            continue;
+        }
+        // an anonymous page reads as zero once given back
+        if (madvise(kma_pool + (long) i * PAGESIZE, PAGESIZE, MADV_DONTNEED) == 0) {
+            page_free[i] = RELEASED;
+            kma_page_stats.num_cached--;
+            released++;
+        }
     }
+    return released * PAGESIZE;
+}
+
+void use_pool(void *base) {
+    assert(base == NULL || kma_pool == NULL);
+
+    kma_pool = base;
+    given_pool = base != NULL;
+    free_head = -1;
+    next_fresh = 0;
+    memset(page_free, 0, sizeof(page_free));
+    kma_page_stats.num_requested = 0;
+    kma_page_stats.num_freed = 0;
+    kma_page_stats.num_in_use = 0;
+    kma_page_stats.num_cached = 0;
+}
 
-    res = next_free_page;
+long save_pages(void *image, long room) {
+    pages_image_t *im = image;
+    int i;
 
-    if (res == NULL) {
-        error("error: all pages already allocated", "");
+    if (room < (long) sizeof(pages_image_t)) {
+        return -1;
     }
+    im->stats = kma_page_stats;
+    im->next_id = next_id;
+    im->free_head = free_head;
+    im->next_fresh = next_fresh;
+    memcpy(im->free_next, free_next, sizeof(free_next));
+    memcpy(im->free_prev, free_prev, sizeof(free_prev));
+    memcpy(im->page_free, page_free, sizeof(page_free));
+    for (i = 0; i < next_fresh; i++) {
+        im->id[i] = page_table[i].id;
+        im->size[i] = page_table[i].size;
+        im->zero[i] = page_table[i].zero;
+    }
+    return sizeof(pages_image_t);
+}
 
-    next_free_page = *((void **) next_free_page);
+int load_pages(void *image, long size) {
+    pages_image_t *im = image;
+    int i;
 
-    assert(res != NULL);
+    assert(given_pool);
 
-    return res;
+    if (size != sizeof(pages_image_t) || im->next_fresh < 0 || im->next_fresh > MAXPAGES) {
+        return FALSE;
+    }
+    kma_page_stats = im->stats;
+    next_id = im->next_id;
+    free_head = im->free_head;
+    next_fresh = im->next_fresh;
+    memcpy(free_next, im->free_next, sizeof(free_next));
+    memcpy(free_prev, im->free_prev, sizeof(free_prev));
+    memcpy(page_free, im->page_free, sizeof(page_free));
+    for (i = 0; i < next_fresh; i++) {
+        page_table[i].id = im->id[i];
+        page_table[i].ptr = kma_pool + i * PAGESIZE;
+        page_table[i].size = im->size[i];
+        page_table[i].zero = im->zero[i];
+    }
+    return TRUE;
 }
 
-void freePage(void *ptr) {
-    assert(ptr != NULL);
+// the index of the first of n pages in a row taken off the free list or
+// the fresh pages, -1 if there are not that many in a row; zero is set if
+// none of them has been written since it was mapped or given back
+int allocPages(int n, int *zero) {
+    int first, i;
 
-    *((void **) ptr) = next_free_page;
-    next_free_page = ptr;
+    if (kma_pool == NULL) {
+        initPages();
+    }
 
-    if (kma_page_stats.num_in_use == 0) {
-        free(pool);
-        pool = NULL;
-        next_free_page = NULL;
+    if (n == 1 && free_head >= 0) {
+        first = free_head;
+    } else if (n == 1 || free_head < 0) {
+        first = next_fresh;
+    } else {
+        // first fit over freed pages and the fresh ones after them
+        for (first = 0, i = 0; i < MAXPAGES && i - first < n; i++) {
+            if (i < next_fresh && !page_free[i]) {
+                first = i + 1;
+            }
+        }
     }
+
+    if (first + n > MAXPAGES) {
+        return -1;
+    }
+
+    *zero = 1;
+    for (i = first; i < first + n && i < next_fresh; i++) {
+        if (page_free[i] == CACHED) {
+            kma_page_stats.num_cached--;
+        }
+        // a file keeps what was written to a page it gives back
+        if (page_free[i] != RELEASED || given_pool) {
+            *zero = 0;
+        }
+        if (free_prev[i] >= 0) {
+            free_next[free_prev[i]] = free_next[i];
+        } else {
+            free_head = free_next[i];
+        }
+        if (free_next[i] >= 0) {
+            free_prev[free_next[i]] = free_prev[i];
+        }
+        page_free[i] = IN_USE;
+    }
+    if (first + n > next_fresh) {
+        next_fresh = first + n;
+    }
+
+    return first;
 }
 
-void initPages() {
+void freePages(int first, int n) {
     int i;
 
-    assert(next_free_page == NULL);
-    assert(pool == NULL);
-
-    //pool = calloc(MAXPAGES, PAGESIZE);
-    int result = posix_memalign(&pool, PAGESIZE, MAXPAGES * PAGESIZE);
-    if (result) {
-        error("Error using posix_memalign to allocate memory", "");
+    kma_page_stats.num_cached += n;
+    for (i = first; i < first + n; i++) {
+        page_free[i] = CACHED;
+        free_prev[i] = -1;
+        free_next[i] = free_head;
+        if (free_head >= 0) {
+            free_prev[free_head] = i;
+        }
+        free_head = i;
     }
-    next_free_page = pool;
 
-    // use ptr to point to the next free page struct
-    for (i = 0; i < (MAXPAGES - 1); i++) {
-        void *ptr = (pool + i * PAGESIZE);
-        void *next = ptr + PAGESIZE;
+    if (kma_page_stats.num_in_use == 0 && !given_pool) {
+        munmap(kma_pool, MAXPAGES * PAGESIZE);
+        kma_pool = NULL;
+        free_head = -1;
+        next_fresh = 0;
+        memset(page_free, 0, sizeof(page_free));
+        kma_page_stats.num_cached = 0;
+    }
+}
 
-        *((void **) ptr) = next;
+void initPages() {
+    assert(free_head < 0);
+    assert(kma_pool == NULL);
+
+    // PAGESIZE alignment: over-map by one page and trim both ends
+    void *map = mmap(NULL, (MAXPAGES + 1) * PAGESIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        error("Error using mmap to allocate memory", "");
+    }
+    kma_pool = BASEADDR(map + PAGESIZE - 1);
+    if (kma_pool > map) {
+        munmap(map, kma_pool - map);
     }
+    munmap(kma_pool + MAXPAGES * PAGESIZE, map + PAGESIZE - kma_pool);
 
-    *((void **) (pool + (MAXPAGES - 1) * PAGESIZE)) = NULL;
+    // pages are handed out in address order, so untouched pages stay
+    // unmapped
+    free_head = -1;
+    next_fresh = 0;
 }
@@ -54,6 +54,7 @@
 #define __KPAGE_H__
 
 /************System include***********************************************/
+#include <pthread.h>
 
 /************Private include**********************************************/
 
@@ -89,6 +90,7 @@ typedef struct {
     int id;
     void *ptr;
     int size;
+    int zero; // not written since the pool was mapped, so all zero
 } kma_page_t;
 
 typedef struct {
@@ -96,10 +98,33 @@ typedef struct {
     int num_freed;
     int num_in_use;
     int page_size;
+    int num_cached; // freed pages whose memory has not been given back
 } kma_page_stat_t;
 
+/*
+ * Links that free lists thread through the blocks of the pool. Built
+ * with KMA_LINK32 a link is a 32-bit offset from the pool base rather
+ * than a pointer, as the pool of MAXPAGES pages is far below 4 GiB; the
+ * NULL link is 0. Offset links stay valid when the pool is mapped
+ * somewhere else, as a heap file may be (see kma_file.h).
+ */
+#ifdef KMA_LINK32
+typedef unsigned int kma_link_t;
+#else
+typedef void *kma_link_t;
+#endif
+
 /************Global Variables*********************************************/
 
+// the first page of the pool, or NULL while no page is in use
+EXTERN void *kma_pool;
+
+// the page layer is not thread safe: where several threads allocate,
+// every call into it, and into the large tier, is made with this held.
+// It is recursive, so that a layer holding it may call into another
+// that takes it too
+EXTERN pthread_mutex_t kma_page_lock;
+
 /************Function Prototypes******************************************/
 
 /***********************************************************************
@@ -111,10 +136,22 @@ typedef struct {
  ***********************************************************************/
 EXTERN kma_page_t *get_page();
 
+/***********************************************************************
+ *  Title: Allocates a run of memory pages
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates n pages that follow each other in the pool,
+ *             reusing freed pages first fit; the descriptor of the
+ *             first page describes the whole run and is given to
+ *             free_page() to release it
+ *    Input: the number of pages
+ *    Output: the run, or NULL if the pool has no n pages in a row
+ ***********************************************************************/
+EXTERN kma_page_t *get_pages(int n);
+
 /***********************************************************************
  *  Title: Releases a memory page 
  * ---------------------------------------------------------------------
- *    Purpose: Releases a memory page
+ *    Purpose: Releases a memory page, or a whole run of them
  *    Input: the pointer to the memory page structure
  *    Output: none
  ***********************************************************************/
@@ -129,8 +166,99 @@ EXTERN void free_page(kma_page_t *);
  ***********************************************************************/
 EXTERN kma_page_stat_t *page_stats();
 
+/***********************************************************************
+ *  Title: Page index
+ * ---------------------------------------------------------------------
+ *    Purpose: Map an address inside an allocated page to the index
+ *             of that page in the pool, so allocators can keep per
+ *             page metadata in a MAXPAGES array instead of walking
+ *             a list
+ *    Input: a pointer into an allocated page
+ *    Output: the page index in [0, MAXPAGES)
+ ***********************************************************************/
+EXTERN int page_index(void *);
+
+/***********************************************************************
+ *  Title: Pool membership
+ * ---------------------------------------------------------------------
+ *    Purpose: Tell pointers into the page pool from any other memory
+ *    Input: a pointer
+ *    Output: TRUE if page_index may be called on it, FALSE otherwise
+ ***********************************************************************/
+EXTERN int page_contains(void *);
+
+/***********************************************************************
+ *  Title: Releases free pages
+ * ---------------------------------------------------------------------
+ *    Purpose: Gives the memory of all but the keep most recently freed
+ *             of the free pages back to the system; they stay in the
+ *             pool, and those of an anonymous pool come back zero
+ *    Input: the number of free pages to keep
+ *    Output: the bytes given back
+ ***********************************************************************/
+EXTERN long release_pages(int keep);
+
+/***********************************************************************
+ *  Title: Page descriptor
+ * ---------------------------------------------------------------------
+ *    Purpose: Find the descriptor get_page() or get_pages() returned
+ *             for the page, or the run, that starts at an address
+ *    Input: the first address of an allocated page or run
+ *    Output: its descriptor
+ ***********************************************************************/
+EXTERN kma_page_t *page_of(void *);
+
+/***********************************************************************
+ *  Title: Places the pool
+ * ---------------------------------------------------------------------
+ *    Purpose: Puts the pool at base, MAXPAGES pages mapped by the
+ *             caller, which stays mapped when no page is in use; NULL
+ *             gives it up for an anonymous mapping made when a page is
+ *             next needed. Either way the pool starts empty
+ *    Input: the page aligned base, or NULL
+ *    Output: none
+ ***********************************************************************/
+EXTERN void use_pool(void *base);
+
+/***********************************************************************
+ *  Title: Saves the page layer
+ * ---------------------------------------------------------------------
+ *    Purpose: Writes which pages are in use, the free lists and the
+ *             statistics to image as indices, which stay valid when the
+ *             pool is mapped elsewhere
+ *    Input: where to write, how many bytes there are
+ *    Output: the bytes written, or -1 if there is not room
+ ***********************************************************************/
+EXTERN long save_pages(void *image, long room);
+
+/***********************************************************************
+ *  Title: Loads the page layer
+ * ---------------------------------------------------------------------
+ *    Purpose: Takes the state save_pages() wrote over for the pool
+ *             given to use_pool(), whose pages it describes
+ *    Input: the image, its size
+ *    Output: TRUE if the image was loaded, FALSE if it is not one
+ ***********************************************************************/
+EXTERN int load_pages(void *image, long size);
+
 /************External Declaration*****************************************/
 
 /**************Definition***************************************************/
 
+static inline kma_link_t kma_link(void *ptr) {
+#ifdef KMA_LINK32
+    return ptr ? (char *) ptr - (char *) kma_pool + 1 : 0;
+#else
+    return ptr;
+#endif
+}
+
+static inline void *kma_ptr(kma_link_t link) {
+#ifdef KMA_LINK32
+    return link ? (char *) kma_pool + link - 1 : NULL;
+#else
+    return link;
+#endif
+}
+
 #endif /* __KPAGE_H__ */
@@ -0,0 +1,179 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: C++ adapters: a std::pmr::memory_resource and a typed STL
+ *             allocator over a KMA backend
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_PMR_H__
+#define __KMA_PMR_H__
+
+/************System include***********************************************/
+// kma.h makes bool a macro, which the C++ headers must not see
+#undef bool
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+/************Private include**********************************************/
+extern "C" {
+#include "kma.h"
+#include "kma_backend.h"
+}
+#undef bool
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/*
+ * Both adapters are bound to one backend, and go through kma_malloc(),
+ * kma_memalign() and kma_free() with kma_current switched to it for the
+ * call, so large objects still go to the large tier and a soft limit
+ * still trims. C++ deallocation is sized, which is all kma_free() needs:
+ * no header is put in front of a block. Blocks aligned to more than
+ * KMA_PMR_ALIGN bytes come from kma_memalign(); none may be aligned to
+ * more than a page. Like the rest of KMA, neither is thread safe.
+ */
+#define KMA_PMR_ALIGN 8
+
+namespace kma {
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Allocates for C++
+ * ---------------------------------------------------------------------
+ *    Purpose: Allocates bytes aligned to align from a backend
+ *    Input: the backend, the size, the alignment
+ *    Output: the block; throws std::bad_alloc on failure
+ ***********************************************************************/
+inline void *allocate(kma_backend_t *backend, std::size_t bytes, std::size_t align);
+
+/***********************************************************************
+ *  Title: Frees for C++
+ * ---------------------------------------------------------------------
+ *    Purpose: Frees a block allocate() gave with the same backend, size
+ *             and alignment
+ *    Input: the backend, the block, the size, the alignment
+ *    Output: none
+ ***********************************************************************/
+inline void deallocate(kma_backend_t *backend, void *ptr, std::size_t bytes, std::size_t align);
+
+/**************Definition***************************************************/
+
+// sets kma_current for the lifetime of the guard
+class scoped_backend {
+  public:
+    explicit scoped_backend(kma_backend_t *backend) : saved(kma_current) {
+        kma_current = backend;
+    }
+    ~scoped_backend() {
+        kma_current = saved;
+    }
+    scoped_backend(const scoped_backend &) = delete;
+    scoped_backend &operator=(const scoped_backend &) = delete;
+
+  private:
+    kma_backend_t *saved;
+};
+
+inline void *allocate(kma_backend_t *backend, std::size_t bytes, std::size_t align) {
+    scoped_backend use(backend);
+    kma_size_t size = bytes ? bytes : 1;
+    void *ptr = align <= KMA_PMR_ALIGN ? kma_malloc(size) : kma_memalign(align, size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+inline void deallocate(kma_backend_t *backend, void *ptr, std::size_t bytes, std::size_t) {
+    scoped_backend use(backend);
+    kma_free(ptr, bytes ? bytes : 1);
+}
+
+// a memory resource for the std::pmr containers; two are equal when they
+// share a backend, as either can free what the other allocated
+class resource : public std::pmr::memory_resource {
+  public:
+    explicit resource(kma_backend_t *backend = kma_current) : backend(backend) {
+    }
+
+    kma_backend_t *get_backend() const {
+        return backend;
+    }
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override {
+        return kma::allocate(backend, bytes, align);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t align) override {
+        kma::deallocate(backend, ptr, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const resource *kma = dynamic_cast<const resource *>(&other);
+        return kma && kma->backend == backend;
+    }
+
+    kma_backend_t *backend;
+};
+
+// a typed allocator for the standard containers, without the virtual
+// calls of a resource
+template <class T>
+class allocator {
+  public:
+    typedef T value_type;
+
+    explicit allocator(kma_backend_t *backend = kma_current) noexcept : backend(backend) {
+    }
+
+    template <class U>
+    allocator(const allocator<U> &other) noexcept : backend(other.get_backend()) {
+    }
+
+    T *allocate(std::size_t n) {
+        if (n > (std::size_t) -1 / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(kma::allocate(backend, n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        kma::deallocate(backend, ptr, n * sizeof(T), alignof(T));
+    }
+
+    kma_backend_t *get_backend() const noexcept {
+        return backend;
+    }
+
+  private:
+    kma_backend_t *backend;
+};
+
+template <class T, class U>
+inline bool operator==(const allocator<T> &a, const allocator<U> &b) noexcept {
+    return a.get_backend() == b.get_backend();
+}
+
+template <class T, class U>
+inline bool operator!=(const allocator<T> &a, const allocator<U> &b) noexcept {
+    return !(a == b);
+}
+
+} // namespace kma
+
+#endif /* __KMA_PMR_H__ */
@@ -0,0 +1,209 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Churn of node-based C++ containers on the KMA backends
+ *             against new_delete_resource
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+/************Private include**********************************************/
+#include "kma_pmr.h"
+extern "C" {
+#include "kma_page.h"
+}
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// live nodes a round builds up to; half of them are then erased at
+// random and put back, before the container is cleared
+#define NODES 4096
+
+typedef std::pair<const int, int> entry_t;
+
+/************Global Variables*********************************************/
+
+static int keys[NODES];
+
+/************Function Prototypes******************************************/
+extern "C" void error(char *, char *);
+
+double now();
+
+template <class MAP>
+double churn_map(MAP &m, int rounds);
+
+template <class LIST>
+double churn_list(LIST &l, int rounds);
+
+template <class MAKER>
+void row(const char *name, const char *kind, int rounds, MAKER make);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 50;
+    kma_backend_t **b;
+    int i, failed = 0;
+
+    if (rounds <= 0) {
+        printf("Usage: %s [rounds] [backend...]\n", argv[0]);
+        exit(0);
+    }
+    srand(1);
+    for (i = 0; i < NODES; i++) {
+        keys[i] = rand();
+    }
+
+    printf("%8s %6s %12s %12s %12s\n", "backend", "kind", "map Mops/s", "list Mops/s", "umap Mops/s");
+    row("new", "pmr", rounds, [](auto churn) { return churn(std::pmr::new_delete_resource()); });
+    for (b = kma_backends; *b; b++) {
+        if (argc > 2) {
+            for (i = 2; i < argc && kma_backend_find(argv[i]) != *b; i++) {
+            }
+            if (i == argc) {
+                continue;
+            }
+        }
+        kma::resource res(*b);
+        row((*b)->name, "pmr", rounds, [&](auto churn) { return churn(&res); });
+        row((*b)->name, "typed", rounds, [&](auto churn) { return churn(*b); });
+        if ((*b)->flush) {
+            (*b)->flush();
+        }
+        if (page_stats()->num_in_use) {
+            printf("%8s: not all pages freed\n", (*b)->name);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mops/s of the inserts and erases of rounds rounds on an empty map
+template <class MAP>
+double churn_map(MAP &m, int rounds) {
+    int r, i;
+
+    double start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < NODES; i++) {
+            m.emplace(keys[i], i);
+        }
+        for (i = r & 1; i < NODES; i += 2) {
+            m.erase(keys[(i * 7) % NODES]);
+        }
+        for (i = r & 1; i < NODES; i += 2) {
+            m.emplace(keys[(i * 7) % NODES], i);
+        }
+        m.clear();
+    }
+    return rounds * 2.5 * NODES / (now() - start) / 1e6;
+}
+
+// the same for a list, erasing every other node
+template <class LIST>
+double churn_list(LIST &l, int rounds) {
+    int r, i;
+
+    double start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < NODES; i++) {
+            l.push_back(keys[i]);
+        }
+        for (auto it = l.begin(); it != l.end();) {
+            it = l.erase(it);
+            if (it != l.end()) {
+                ++it;
+            }
+        }
+        for (i = 0; i < NODES / 2; i++) {
+            l.push_front(keys[i]);
+        }
+        l.clear();
+    }
+    return rounds * 2.5 * NODES / (now() - start) / 1e6;
+}
+
+// the three containers with the allocator make() gives, or "-" for one a
+// backend could not serve
+template <class MAKER>
+void row(const char *name, const char *kind, int rounds, MAKER make) {
+    double mops[3];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        try {
+            mops[i] = make([&](auto alloc) {
+                typedef std::less<int> less_t;
+                typedef std::hash<int> hash_t;
+                typedef std::equal_to<int> equal_t;
+                if constexpr (std::is_same_v<decltype(alloc), kma_backend_t *>) {
+                    if (i == 0) {
+                        std::map<int, int, less_t, kma::allocator<entry_t>> m{kma::allocator<entry_t>(alloc)};
+                        return churn_map(m, rounds);
+                    } else if (i == 1) {
+                        std::list<int, kma::allocator<int>> l{kma::allocator<int>(alloc)};
+                        return churn_list(l, rounds);
+                    }
+                    std::unordered_map<int, int, hash_t, equal_t, kma::allocator<entry_t>> u{kma::allocator<entry_t>(alloc)};
+                    return churn_map(u, rounds);
+                } else {
+                    if (i == 0) {
+                        std::pmr::map<int, int> m{alloc};
+                        return churn_map(m, rounds);
+                    } else if (i == 1) {
+                        std::pmr::list<int> l{alloc};
+                        return churn_list(l, rounds);
+                    }
+                    std::pmr::unordered_map<int, int> u{alloc};
+                    return churn_map(u, rounds);
+                }
+            });
+        } catch (std::bad_alloc &) {
+            mops[i] = -1;
+        }
+    }
+    printf("%8s %6s", name, kind);
+    for (i = 0; i < 3; i++) {
+        if (mops[i] < 0) {
+            printf(" %12s", "-");
+        } else {
+            printf(" %12.2f", mops[i]);
+        }
+    }
+    printf("\n");
+}
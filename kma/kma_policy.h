@@ -0,0 +1,588 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Allocators put together at compile time from policies for
+ *             the slab size, size classes, free lists and reclaim
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_POLICY_H__
+#define __KMA_POLICY_H__
+
+/************System include***********************************************/
+// kma.h makes bool a macro, which the C++ headers must not see
+#undef bool
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/************Private include**********************************************/
+extern "C" {
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_sizeclass.h"
+}
+#undef bool
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/*
+ * What the C backends each write out by hand, and fix with #defines
+ * (MINPOWER, FL_SIZE, the page_stat[MAXPAGES] arrays and the loops that
+ * thread a fresh page), is here once, with the choices as template
+ * parameters:
+ *   Slab    - slab_pages<bytes>: how much an allocator takes from the
+ *             page layer at a time, a whole number of pages
+ *   Classes - sc_classes (the classes of kma_sizeclass.h, as built) or
+ *             pow2_classes<min, max>
+ *   Lists   - slab_lists: each slab threads its own free blocks, and
+ *             slabs with free blocks sit on a list per class (mck2);
+ *             class_lists: one list per class across all slabs (p2fl)
+ *   Links   - ptr_links or offset_links (32-bit pool offsets, as
+ *             KMA_LINK32 has them); build_links follows the build
+ *   Reclaim - reclaim_keep<n>: up to n empty slabs per allocator stay
+ *             for reuse, the rest go back as soon as they empty;
+ *             reclaim_empty is reclaim_keep<0>
+ * An allocator is a class of static functions and state, so each
+ * instantiation is a backend of its own, and what a policy decides is
+ * a constant in its hot paths. backend<A>() makes a kma_backend_t of one.
+ * Metadata lives off the slabs in MAXPAGES arrays, indexed by the pool
+ * page a slab starts at. Not thread safe, like the C backends.
+ */
+
+namespace kma {
+namespace policy {
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+// the pool page an address lies in
+inline int pool_page(void *ptr) {
+    return ((char *) ptr - (char *) kma_pool) / PAGESIZE;
+}
+
+template <kma_size_t Bytes>
+struct slab_pages {
+    static_assert(Bytes % PAGESIZE == 0 && Bytes / PAGESIZE >= 1 && Bytes / PAGESIZE <= MAXPAGES,
+                  "a slab is a whole number of pool pages");
+
+    static constexpr int pages = Bytes / PAGESIZE;
+    static constexpr kma_size_t size = Bytes;
+
+    // for a slab of several pages, the first page of the slab each of
+    // them belongs to
+    static inline int first[pages > 1 ? MAXPAGES : 1];
+
+    static kma_page_t *get() {
+        if constexpr (pages == 1) {
+            return get_page();
+        } else {
+            kma_page_t *page = get_pages(pages);
+            if (page) {
+                int at = pool_page(page->ptr), i;
+                for (i = 0; i < pages; i++) {
+                    first[at + i] = at;
+                }
+            }
+            return page;
+        }
+    }
+
+    // the first page of the slab ptr lies in
+    static int slab(void *ptr) {
+        if constexpr (pages == 1) {
+            return pool_page(ptr);
+        } else {
+            return first[pool_page(ptr)];
+        }
+    }
+};
+
+// the table of a trace-tuned set is indexed by size / 16 too, so no
+// class is below 16 bytes either way
+struct sc_classes {
+    static constexpr int count = KMA_SC_NCLASSES;
+    static constexpr kma_size_t min = 16;
+
+    static kma_size_t index(kma_size_t size) {
+        return kma_sc_index(size);
+    }
+
+    static kma_size_t size(kma_size_t idx) {
+        return kma_sc_size[idx];
+    }
+};
+
+template <int MinShift, int MaxShift>
+struct pow2_classes {
+    static_assert(MinShift >= 3 && MinShift <= MaxShift, "classes from 8 bytes up");
+
+    static constexpr int count = MaxShift - MinShift + 1;
+    static constexpr kma_size_t min = 1L << MinShift;
+
+    static kma_size_t index(kma_size_t size) {
+        return size <= (1L << MinShift) ? 0 : 64 - __builtin_clzl(size - 1) - MinShift;
+    }
+
+    static constexpr kma_size_t size(kma_size_t idx) {
+        return 1L << (MinShift + idx);
+    }
+};
+
+struct slab_lists {
+};
+
+struct class_lists {
+};
+
+// a link is kept at block + at; a block holds two
+struct ptr_links {
+    static constexpr int size = sizeof(void *);
+
+    static void *get(void *block, int at = 0) {
+        return *(void **) ((char *) block + at);
+    }
+
+    static void set(void *block, void *to, int at = 0) {
+        *(void **) ((char *) block + at) = to;
+    }
+};
+
+struct offset_links {
+    static constexpr int size = sizeof(uint32_t);
+
+    static void *get(void *block, int at = 0) {
+        uint32_t link = *(uint32_t *) ((char *) block + at);
+        return link ? (char *) kma_pool + link - 1 : NULL;
+    }
+
+    static void set(void *block, void *to, int at = 0) {
+        *(uint32_t *) ((char *) block + at) = to ? (char *) to - (char *) kma_pool + 1 : 0;
+    }
+};
+
+#ifdef KMA_LINK32
+typedef offset_links build_links;
+#else
+typedef ptr_links build_links;
+#endif
+
+template <int Keep>
+struct reclaim_keep {
+    static_assert(Keep >= 0, "a number of slabs");
+
+    static constexpr int keep = Keep;
+};
+
+typedef reclaim_keep<0> reclaim_empty;
+
+/*
+ * Blocks of one class lie back to back from the start of a slab. With
+ * class_lists the lists are doubly linked, so that a slab that empties
+ * takes its blocks off its class list one by one instead of filtering
+ * the list as p2fl does.
+ */
+template <class Classes, class Lists, class Slab = slab_pages<PAGESIZE>,
+          class Links = build_links, class Reclaim = reclaim_empty>
+class segregated {
+    static constexpr bool by_slab = std::is_same<Lists, slab_lists>::value;
+
+    static_assert(by_slab || std::is_same<Lists, class_lists>::value, "slab_lists or class_lists");
+    static_assert(Classes::min >= (by_slab ? 1 : 2) * Links::size, "blocks hold their links");
+
+    typedef struct slab_t {
+        kma_page_t *page;
+        kma_size_t idx;
+        int used;
+        void *free;          // slab_lists only
+        struct slab_t *prev; // on the partial list, slab_lists only
+        struct slab_t *next;
+    } slab_t;
+
+    static inline slab_t meta[MAXPAGES];
+    static inline slab_t *partial[Classes::count];
+    static inline void *heads[Classes::count];
+    static inline int empty = 0;
+
+    static slab_t *slab_of(void *ptr) {
+        return meta + Slab::slab(ptr);
+    }
+
+    static void push_partial(slab_t *s) {
+        s->prev = NULL;
+        s->next = partial[s->idx];
+        if (s->next) {
+            s->next->prev = s;
+        }
+        partial[s->idx] = s;
+    }
+
+    static void unlink_partial(slab_t *s) {
+        if (s->prev) {
+            s->prev->next = s->next;
+        } else {
+            partial[s->idx] = s->next;
+        }
+        if (s->next) {
+            s->next->prev = s->prev;
+        }
+    }
+
+    static void push_block(kma_size_t idx, void *block) {
+        Links::set(block, heads[idx]);
+        Links::set(block, NULL, Links::size);
+        if (heads[idx]) {
+            Links::set(heads[idx], block, Links::size);
+        }
+        heads[idx] = block;
+    }
+
+    static void unlink_block(kma_size_t idx, void *block) {
+        void *prev = Links::get(block, Links::size);
+        void *next = Links::get(block);
+        if (prev) {
+            Links::set(prev, next);
+        } else {
+            heads[idx] = next;
+        }
+        if (next) {
+            Links::set(next, prev, Links::size);
+        }
+    }
+
+    // a fresh slab of class idx with all its blocks free
+    static bool grow(kma_size_t idx) {
+        kma_size_t bufsize = Classes::size(idx);
+        kma_page_t *page = Slab::get();
+        if (!page) {
+            return false;
+        }
+        slab_t *s = slab_of(page->ptr);
+        char *first = (char *) page->ptr;
+        char *last = first + (Slab::size / bufsize - 1) * bufsize;
+        char *ptr;
+        s->page = page;
+        s->idx = idx;
+        s->used = 0;
+        if constexpr (by_slab) {
+            for (ptr = first; ptr < last; ptr += bufsize) {
+                Links::set(ptr, ptr + bufsize);
+            }
+            Links::set(ptr, NULL);
+            s->free = first;
+            push_partial(s);
+        } else {
+            for (ptr = last; ptr >= first; ptr -= bufsize) {
+                push_block(idx, ptr);
+            }
+        }
+        empty++;
+        return true;
+    }
+
+    // the slab is free; it stays while fewer than Reclaim::keep others
+    // do, unless all are to go
+    static void release(slab_t *s, bool all) {
+        if (!all && empty < Reclaim::keep) {
+            empty++;
+            return;
+        }
+        if constexpr (by_slab) {
+            unlink_partial(s);
+        } else {
+            kma_size_t bufsize = Classes::size(s->idx);
+            char *ptr = (char *) s->page->ptr;
+            char *last = ptr + (Slab::size / bufsize - 1) * bufsize;
+            for (; ptr <= last; ptr += bufsize) {
+                unlink_block(s->idx, ptr);
+            }
+        }
+        free_page(s->page);
+    }
+
+  public:
+    static void *malloc(kma_size_t size) {
+        if (size <= 0 || size > Classes::size(Classes::count - 1)) {
+            return NULL;
+        }
+        kma_size_t idx = Classes::index(size);
+        if (Classes::size(idx) > Slab::size) {
+            return NULL;
+        }
+        void *block;
+        if constexpr (by_slab) {
+            if (!partial[idx] && !grow(idx)) {
+                return NULL;
+            }
+            slab_t *s = partial[idx];
+            block = s->free;
+            s->free = Links::get(block);
+            if (!s->used++) {
+                empty--;
+            }
+            if (!s->free) {
+                unlink_partial(s);
+            }
+        } else {
+            if (!heads[idx] && !grow(idx)) {
+                return NULL;
+            }
+            block = heads[idx];
+            unlink_block(idx, block);
+            slab_t *s = slab_of(block);
+            if (!s->used++) {
+                empty--;
+            }
+        }
+        return block;
+    }
+
+    static void free(void *ptr, kma_size_t) {
+        slab_t *s = slab_of(ptr);
+        if constexpr (by_slab) {
+            if (!s->free) {
+                push_partial(s);
+            }
+            Links::set(ptr, s->free);
+            s->free = ptr;
+        } else {
+            push_block(s->idx, ptr);
+        }
+        if (!--s->used) {
+            release(s, false);
+        }
+    }
+
+    static kma_size_t size(void *ptr) {
+        return Classes::size(slab_of(ptr)->idx);
+    }
+
+    // a class whose size is a multiple of align aligns all its blocks
+    static void *memalign(kma_size_t align, kma_size_t size) {
+        if (size <= 0 || size > Slab::size) {
+            return NULL;
+        }
+        kma_size_t idx = Classes::index(size);
+        while (idx < Classes::count && (Classes::size(idx) & (align - 1))) {
+            idx++;
+        }
+        return idx < Classes::count ? malloc(Classes::size(idx)) : NULL;
+    }
+
+    static void flush() {
+        int idx;
+        for (idx = 0; idx < Classes::count && empty; idx++) {
+            if constexpr (by_slab) {
+                slab_t *s = partial[idx];
+                while (s) {
+                    slab_t *next = s->next;
+                    if (!s->used) {
+                        empty--;
+                        release(s, true);
+                    }
+                    s = next;
+                }
+            } else {
+                void *block = heads[idx];
+                while (block) {
+                    slab_t *s = slab_of(block);
+                    if (!s->used) {
+                        // the blocks of s, this one included, go
+                        empty--;
+                        release(s, true);
+                        block = heads[idx];
+                    } else {
+                        block = Links::get(block);
+                    }
+                }
+            }
+        }
+    }
+};
+
+/*
+ * Blocks are 1 << (MinShift + order) bytes, up to the whole slab, and a
+ * block and its buddy are told apart by their offset in the slab. The
+ * state of every MinShift unit of the pool is a byte off the slab: for
+ * the first unit of a block, its order, with FREE set while it is on a
+ * free list. The lists are per order across slabs, doubly linked.
+ */
+template <int MinShift, class Slab = slab_pages<PAGESIZE>, class Links = build_links,
+          class Reclaim = reclaim_empty>
+class buddy {
+    static constexpr int unit = 1 << MinShift;
+    static constexpr int top = __builtin_ctzl(Slab::size) - MinShift;
+    static constexpr unsigned char FREE = 0x80;
+
+    static_assert((Slab::size & (Slab::size - 1)) == 0, "a slab of a power of two bytes");
+    static_assert(unit >= 2 * Links::size && top >= 0 && top < FREE, "blocks hold their links");
+
+    static inline unsigned char state[(long) MAXPAGES * PAGESIZE / unit];
+    static inline kma_page_t *pages[MAXPAGES];
+    static inline void *heads[top + 1];
+    static inline int empty = 0;
+
+    static long unit_of(void *ptr) {
+        return ((char *) ptr - (char *) kma_pool) >> MinShift;
+    }
+
+    static int order_of(kma_size_t size) {
+        return size <= unit ? 0 : 64 - __builtin_clzl(size - 1) - MinShift;
+    }
+
+    static void push(int order, void *block) {
+        state[unit_of(block)] = order | FREE;
+        Links::set(block, heads[order]);
+        Links::set(block, NULL, Links::size);
+        if (heads[order]) {
+            Links::set(heads[order], block, Links::size);
+        }
+        heads[order] = block;
+    }
+
+    static void unlink(int order, void *block) {
+        void *prev = Links::get(block, Links::size);
+        void *next = Links::get(block);
+        if (prev) {
+            Links::set(prev, next);
+        } else {
+            heads[order] = next;
+        }
+        if (next) {
+            Links::set(next, prev, Links::size);
+        }
+    }
+
+    static void release(void *block) {
+        int at = Slab::slab(block);
+        kma_page_t *page = pages[at];
+        pages[at] = NULL;
+        free_page(page);
+    }
+
+  public:
+    static void *malloc(kma_size_t size) {
+        if (size <= 0 || size > Slab::size) {
+            return NULL;
+        }
+        int order = order_of(size), from;
+        for (from = order; from <= top && !heads[from]; from++) {
+        }
+        char *block;
+        if (from > top) {
+            kma_page_t *page = Slab::get();
+            if (!page) {
+                return NULL;
+            }
+            pages[Slab::slab(page->ptr)] = page;
+            from = top;
+            block = (char *) page->ptr;
+        } else {
+            block = (char *) heads[from];
+            unlink(from, block);
+            if (from == top) {
+                empty--;
+            }
+        }
+        while (from > order) {
+            from--;
+            push(from, block + ((kma_size_t) unit << from));
+        }
+        state[unit_of(block)] = order;
+        return block;
+    }
+
+    static void free(void *ptr, kma_size_t) {
+        char *block = (char *) ptr;
+        char *base = (char *) kma_pool + (long) Slab::slab(ptr) * PAGESIZE;
+        int order = state[unit_of(block)];
+        while (order < top) {
+            char *mate = base + ((block - base) ^ ((kma_size_t) unit << order));
+            if (state[unit_of(mate)] != (order | FREE)) {
+                break;
+            }
+            unlink(order, mate);
+            state[unit_of(mate)] = 0;
+            if (mate < block) {
+                state[unit_of(block)] = 0;
+                block = mate;
+            }
+            order++;
+        }
+        if (order == top && empty >= Reclaim::keep) {
+            state[unit_of(block)] = 0;
+            release(block);
+            return;
+        }
+        if (order == top) {
+            empty++;
+        }
+        push(order, block);
+    }
+
+    static kma_size_t size(void *ptr) {
+        return (kma_size_t) unit << state[unit_of(ptr)];
+    }
+
+    // blocks are aligned to their size within slabs that start on pages
+    static void *memalign(kma_size_t align, kma_size_t size) {
+        return malloc(size < align ? align : size);
+    }
+
+    static void flush() {
+        while (heads[top]) {
+            void *block = heads[top];
+            unlink(top, block);
+            state[unit_of(block)] = 0;
+            empty--;
+            release(block);
+        }
+    }
+};
+
+// a backend whose hooks are the allocator's static functions
+template <class A>
+kma_backend_t backend(const char *name) {
+    kma_backend_t b = {};
+
+    b.name = const_cast<char *>(name);
+    b.malloc = A::malloc;
+    b.free = A::free;
+    b.flush = A::flush;
+    b.size = A::size;
+    b.memalign = A::memalign;
+    return b;
+}
+
+/*
+ * The C backends as instantiations. tmck2 and tp2fl differ only in
+ * their lists and classes; neither keeps a tag in front of a block, as
+ * p2fl does, since a block's class is on its slab.
+ */
+typedef segregated<sc_classes, slab_lists> tmck2;
+
+typedef segregated<pow2_classes<4, 13>, class_lists> tp2fl;
+
+typedef buddy<5> tbud;
+
+} // namespace policy
+} // namespace kma
+
+#endif /* __KMA_POLICY_H__ */
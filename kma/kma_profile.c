@@ -0,0 +1,382 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Per size bucket waste and throughput of every backend, and
+ *             the KMA_HYBRID routing table they give
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_hybrid.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// backends within this fraction of the least waste count as tied, and
+// the faster one wins
+#define TIE 0.05
+
+// seconds a backend may take on one bucket before it counts as failed
+#define TIMEOUT 30
+
+// one allocation (size > 0) or free (size 0) of the trace
+typedef struct event_t {
+    int id;
+    kma_size_t size;
+    kma_size_t bucket; // of the block allocated or freed
+} event_t;
+
+typedef struct result_t {
+    double waste; // average waste ratio, as in competition mode
+    double mops;
+    int ok;
+} result_t;
+
+/************Global Variables*********************************************/
+
+// the trace with every record broken down into allocations and frees
+static event_t *events;
+static int numEvents = 0;
+static int numIds = 0;
+
+/************Function Prototypes******************************************/
+void error(char *, char *);
+
+double now();
+
+void load(char *);
+
+result_t measure(kma_backend_t *, kma_size_t);
+
+result_t replay(kma_backend_t *, kma_size_t);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    kma_backend_t **b;
+    kma_hybrid_route_t table[KMA_HYBRID_NBUCKETS];
+    int bucket, i;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s traceFile [outHeader]\n", argv[0]);
+        exit(0);
+    }
+    load(argv[1]);
+
+    int n = 0;
+    for (b = kma_backends; *b; b++) {
+        n++;
+    }
+    result_t *res = malloc(n * sizeof(result_t));
+    assert(res != NULL);
+
+    printf("%6s", "bucket");
+    for (b = kma_backends; *b; b++) {
+        if (*b != &kma_hybrid_backend) {
+            printf(" %14s", (*b)->name);
+        }
+    }
+    printf("\n");
+    for (bucket = 0; bucket < KMA_HYBRID_NBUCKETS; bucket++) {
+        int best = -1, next = -1;
+
+        printf("%6d", (1 << KMA_HYBRID_LG_MIN) << bucket);
+        for (b = kma_backends, i = 0; *b; b++, i++) {
+            if (*b == &kma_hybrid_backend) {
+                res[i].ok = 0;
+                continue;
+            }
+            res[i] = measure(*b, bucket);
+            if (res[i].ok) {
+                printf(" %6.2f/%7.2f", res[i].waste, res[i].mops);
+            } else {
+                printf(" %14s", "failed");
+            }
+        }
+        printf("\n");
+
+        // the least waste first; the faster of two close ones
+        int pass;
+        for (pass = 0; pass < 2; pass++) {
+            int pick = -1;
+            for (i = 0; i < n; i++) {
+                if (!res[i].ok || i == best) {
+                    continue;
+                }
+                if (pick < 0 || res[i].waste < res[pick].waste * (1 - TIE)
+                    || (res[i].waste <= res[pick].waste * (1 + TIE) && res[i].mops > res[pick].mops)) {
+                    pick = i;
+                }
+            }
+            if (pass == 0) {
+                best = pick;
+            } else {
+                next = pick;
+            }
+        }
+        table[bucket].engine = best >= 0 ? kma_backends[best]->name : "mck2";
+        table[bucket].waste = best >= 0 && res[best].mops ? res[best].waste : -1;
+        table[bucket].alternate = next >= 0 ? kma_backends[next]->name : NULL;
+        table[bucket].alternate_waste = next >= 0 && res[next].mops ? res[next].waste : -1;
+    }
+    printf("(waste ratio/Mops per second; buckets by largest size)\n");
+
+    for (bucket = 0; bucket < KMA_HYBRID_NBUCKETS; bucket++) {
+        printf("%6d: %s, then %s\n", (1 << KMA_HYBRID_LG_MIN) << bucket, table[bucket].engine,
+               table[bucket].alternate ? table[bucket].alternate : "none");
+    }
+
+    if (argc == 3) {
+        FILE *f = fopen(argv[2], "w");
+        if (f == NULL) {
+            error("unable to open output header", argv[2]);
+        }
+        fprintf(f, "/* generated by kma_profile from %s, do not edit */\n\n", argv[1]);
+        fprintf(f, "static kma_hybrid_route_t kma_hybrid_table[KMA_HYBRID_NBUCKETS] = {\n");
+        for (bucket = 0; bucket < KMA_HYBRID_NBUCKETS; bucket++) {
+            kma_hybrid_route_t *r = table + bucket;
+            fprintf(f, "    { \"%s\", %.2f, ", r->engine, r->waste);
+            if (r->alternate) {
+                fprintf(f, "\"%s\", %.2f }", r->alternate, r->alternate_waste);
+            } else {
+                fprintf(f, "NULL, -1 }");
+            }
+            fprintf(f, "%s\n", bucket < KMA_HYBRID_NBUCKETS - 1 ? "," : "");
+        }
+        fprintf(f, "};\n");
+        fclose(f);
+    }
+    free(res);
+    free(events);
+    return 0;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void add(int id, kma_size_t size, kma_size_t bucket) {
+    static int capacity = 0;
+
+    if (id < 0 || id >= numIds) {
+        error("request id out of range", "");
+    }
+    if (numEvents == capacity) {
+        capacity = capacity ? 2 * capacity : 1024;
+        events = realloc(events, capacity * sizeof(event_t));
+        assert(events != NULL);
+    }
+    events[numEvents].id = id;
+    events[numEvents].size = size;
+    events[numEvents].bucket = bucket;
+    numEvents++;
+}
+
+void load(char *file) {
+    FILE *f = fopen(file, "r");
+    char command[16];
+    int id, size, align, count, arena, i;
+
+    if (f == NULL) {
+        error("unable to open trace file", file);
+    }
+    if (fscanf(f, "%d", &numIds) != 1) {
+        error("missing request count in trace", file);
+    }
+    numIds /= 2;
+
+    // what each id holds now, for the bucket of its free, and the arena
+    // it came from, for a DESTROY
+    kma_size_t *live = calloc(numIds, sizeof(kma_size_t));
+    int *arenaOf = malloc(numIds * sizeof(int));
+    assert(live != NULL && arenaOf != NULL);
+
+#define ALLOC(id, size) \
+    (add(id, size, kma_hybrid_bucket(size)), live[id] = size, arenaOf[id] = -1)
+#define FREE(id) \
+    (live[id] ? (add(id, 0, kma_hybrid_bucket(live[id])), live[id] = 0) : 0)
+
+    while (fscanf(f, "%15s", command) == 1) {
+        if (strcmp(command, "REQUEST") == 0 || strcmp(command, "CALLOC") == 0) {
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                error("malformed REQUEST", file);
+            }
+            ALLOC(id, size);
+        } else if (strcmp(command, "ALIGNED") == 0) {
+            if (fscanf(f, "%d %d %d", &id, &size, &align) != 3) {
+                error("malformed ALIGNED", file);
+            }
+            ALLOC(id, size);
+        } else if (strcmp(command, "BATCH") == 0) {
+            if (fscanf(f, "%d %d %d", &id, &count, &size) != 3) {
+                error("malformed BATCH", file);
+            }
+            for (i = 0; i < count; i++) {
+                ALLOC(id + i, size);
+            }
+        } else if (strcmp(command, "BATCHFREE") == 0) {
+            if (fscanf(f, "%d %d", &id, &count) != 2) {
+                error("malformed BATCHFREE", file);
+            }
+            for (i = 0; i < count; i++) {
+                FREE(id + i);
+            }
+        } else if (strcmp(command, "ARENA") == 0) {
+            if (fscanf(f, "%d %d %d", &arena, &id, &size) != 3) {
+                error("malformed ARENA", file);
+            }
+            ALLOC(id, size);
+            arenaOf[id] = arena;
+        } else if (strcmp(command, "DESTROY") == 0) {
+            if (fscanf(f, "%d", &arena) != 1) {
+                error("malformed DESTROY", file);
+            }
+            for (i = 0; i < numIds; i++) {
+                if (live[i] && arenaOf[i] == arena) {
+                    FREE(i);
+                }
+            }
+        } else if (strcmp(command, "FREE") == 0) {
+            if (fscanf(f, "%d", &id) != 1) {
+                error("malformed FREE", file);
+            }
+            FREE(id);
+        } else if (strcmp(command, "REALLOC") == 0) {
+            // a move, which may change the bucket
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                error("malformed REALLOC", file);
+            }
+            FREE(id);
+            ALLOC(id, size);
+        } else {
+            error("unknown command in trace", command);
+        }
+    }
+
+#undef ALLOC
+#undef FREE
+
+    free(live);
+    free(arenaOf);
+    fclose(f);
+}
+
+// replay() in a child, so that a backend that crashes, hangs or leaks
+// pages on a bucket is only marked failed there
+result_t measure(kma_backend_t *backend, kma_size_t bucket) {
+    result_t res = {0, 0, 0};
+    int fd[2], status;
+
+    if (pipe(fd) < 0) {
+        error("unable to create pipe", backend->name);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        error("unable to fork", backend->name);
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        alarm(TIMEOUT);
+        res = replay(backend, bucket);
+        if (write(fd[1], &res, sizeof(res)) != sizeof(res)) {
+            exit(-1);
+        }
+        exit(0);
+    }
+    close(fd[1]);
+    if (read(fd[0], &res, sizeof(res)) != sizeof(res)) {
+        res.ok = 0;
+    }
+    close(fd[0]);
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        res.ok = 0;
+    }
+    return res;
+}
+
+// the trace's events of one bucket through one backend
+result_t replay(kma_backend_t *backend, kma_size_t bucket) {
+    result_t res = {0, 0, 1};
+    void **ptr = calloc(numIds, sizeof(void *));
+    kma_size_t *size = calloc(numIds, sizeof(kma_size_t));
+    long live = 0;
+    int samples = 0, ops = 0, i;
+    double elapsed = 0;
+
+    assert(ptr != NULL && size != NULL);
+    kma_current = backend;
+    for (i = 0; i < numEvents; i++) {
+        event_t *ev = events + i;
+        if (ev->bucket != bucket) {
+            continue;
+        }
+        double start = now();
+        if (ev->size) {
+            ptr[ev->id] = kma_malloc(ev->size);
+            size[ev->id] = ev->size;
+        } else if (ptr[ev->id]) {
+            kma_free(ptr[ev->id], size[ev->id]);
+        }
+        elapsed += now() - start;
+        ops++;
+
+        if (ev->size && ptr[ev->id]) {
+            live += ev->size;
+        } else if (ev->size && ev->size <= PAGESIZE - (int) sizeof(void *)) {
+            res.ok = 0;
+            break;
+        } else if (!ev->size && ptr[ev->id]) {
+            live -= size[ev->id];
+            ptr[ev->id] = NULL;
+        }
+        if (live) {
+            res.waste += (double)(page_stats()->num_in_use * PAGESIZE - live) / live;
+            samples++;
+        }
+    }
+    if (backend->flush) {
+        backend->flush();
+    }
+    if (page_stats()->num_in_use) {
+        res.ok = 0;
+    }
+    res.waste = samples ? res.waste / samples : 0;
+    res.mops = elapsed > 0 ? ops / elapsed / 1e6 : 0;
+    free(ptr);
+    free(size);
+    return res;
+}
@@ -41,15 +41,18 @@
  
  ***************************************************************************/
 
-#ifdef KMA_RM
 #define __KMA_IMPL__
+#define __KMA_HANDLE_IMPL__
 
 /************System include***********************************************/
 #include <stdlib.h>
+#include <string.h>
 
 /************Private include**********************************************/
 #include "kma_page.h"
 #include "kma.h"
+#include "kma_backend.h"
+#include "kma_handle.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -60,140 +63,601 @@
 
 /************Global Variables*********************************************/
 
+int kma_compact_moves = 0;
+
+int kma_compact_released = 0;
+
 /************Function Prototypes******************************************/
 
 /************External Declaration*****************************************/
 
 /**************Implementation***********************************************/
 
-#define PTRSIZE sizeof(void *)
-#define INTSIZE sizeof(kma_size_t)
+/*
+ * Every page is a resource map of its own: its free blocks form an
+ * address-ordered list headed in page_stat, so a freed block finds the
+ * neighbours it coalesces with without looking at other pages. Blocks
+ * are rounded to ALIGN bytes, the size of a free block header, which
+ * keeps room for one in every remainder; with KMA_LINK32 that is 8
+ * rather than 16. Pages are linked in the order they were taken and
+ * searched first fit. Every byte of a page from clean on is zero:
+ * nothing has been handed out or written there since it was mapped.
+ *
+ * Blocks of kma_halloc() get pages of their own, so that nothing on
+ * them is reached by address while it is not pinned. Their handles
+ * index a table kept on pages from the page layer and given back once
+ * no handle is left; the blocks of a page are chained through the
+ * table, which lets kma_compact() find what to move off it.
+ *
+ * rm_save() keeps the pages of both lists in order, with the handle
+ * table, as pool indices and offsets. Links and handle entries on the
+ * pages are pool offsets under KMA_LINK32, so rm_restore() leaves the
+ * pages alone; pointers are moved by how far the pool has.
+ */
+typedef struct free_block_t {
+    kma_link_t next;
+    int size; // bytes in the block, header included, at most a page
+} free_block_t;
 
+#define ALIGN ((int) sizeof(free_block_t))
+#define ROUND(x) (((x) + ALIGN - 1) & ~(ALIGN - 1))
+#define FB(link) ((free_block_t *) kma_ptr(link))
+
+// a page of kma_compact() moves blocks off only while at most this
+// much of it is in use
+#define SPARSE (PAGESIZE / 2)
+
+typedef struct page_list_t {
+    struct page_wrapper_t *head;
+    struct page_wrapper_t *tail;
+    int pages;
+    kma_size_t live; // rounded bytes of handle blocks on them
+} page_list_t;
 
 typedef struct page_wrapper_t {
-    void *fb_head;
+    kma_link_t fb_head;
     kma_page_t *page;
+    void *clean;
+    page_list_t *list;
+    struct page_wrapper_t *prev;
     struct page_wrapper_t *next;
+    kma_size_t live;
+    int pinned; // pins on its handle blocks
+    kma_handle_t handles; // its first handle block
 } page_wrapper_t;
 
-page_wrapper_t page_stat[MAXPAGES];
-page_wrapper_t *page_head = NULL;
-page_wrapper_t *free_head = NULL;
+typedef struct handle_t {
+    kma_link_t ptr;
+    int size; // at most a page
+    int pins;
+    kma_handle_t next; // on the same page, or the next free handle
+} handle_t;
+
+#define HANDLES_PER_PAGE (PAGESIZE / (int) sizeof(handle_t))
+
+static page_wrapper_t page_stat[MAXPAGES];
+static page_list_t blocks = {NULL, NULL, 0, 0};
+static page_list_t movable = {NULL, NULL, 0, 0};
+
+static kma_page_t *table[MAXPAGES];
+static int n_handles = 0;
+static int live_handles = 0;
+static kma_handle_t free_handles = KMA_NO_HANDLE;
+
+typedef struct page_image_t {
+    int index;
+    int fb_head; // offset from the pool, -1 for none
+    int clean; // offset into the page
+    kma_handle_t handles;
+    kma_size_t live;
+} page_image_t;
+
+// what rm_save() writes: the page_image_t of blocks, then of movable,
+// follow the header
+typedef struct rm_image_t {
+    long pool; // where the pool was
+    int pages[2];
+    kma_size_t live[2];
+    int n_handles;
+    int live_handles;
+    kma_handle_t free_handles;
+    int table[MAXPAGES];
+} rm_image_t;
+
+
+
+// NULL when the pool is full, which the shim falls back from
+static page_wrapper_t *new_page(page_list_t *list) {
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    page_wrapper_t *pw = page_stat + page_index(page->ptr);
+    pw->page = page;
+    free_block_t *fb = page->ptr;
+    fb->next = kma_link(NULL);
+    fb->size = page->size;
+    pw->fb_head = kma_link(fb);
+    pw->clean = page->zero ? page->ptr + sizeof(free_block_t) : page->ptr + page->size;
+    pw->list = list;
+    pw->prev = list->tail;
+    pw->next = NULL;
+    pw->live = 0;
+    pw->pinned = 0;
+    pw->handles = KMA_NO_HANDLE;
+    if (list->tail) {
+        list->tail->next = pw;
+    } else {
+        list->head = pw;
+    }
+    list->tail = pw;
+    list->pages++;
+    return pw;
+}
+
+
+static void release_page(page_wrapper_t *pw) {
+    page_list_t *list = pw->list;
+    if (pw->prev) {
+        pw->prev->next = pw->next;
+    } else {
+        list->head = pw->next;
+    }
+    if (pw->next) {
+        pw->next->prev = pw->prev;
+    } else {
+        list->tail = pw->prev;
+    }
+    list->pages--;
+    free_page(pw->page);
+}
+
+
+// the bytes below end may have been written
+static void mark_written(page_wrapper_t *pw, void *end) {
+    if (end > pw->clean) {
+        pw->clean = end;
+    }
+}
+
+
+// cut size bytes off the front of the free block *link
+static void *take_block(page_wrapper_t *pw, kma_link_t *link, kma_size_t size) {
+    free_block_t *fb = FB(*link);
+    if (fb->size > size) {
+        free_block_t *rest = (void *)fb + size;
+        rest->next = fb->next;
+        rest->size = fb->size - size;
+        *link = kma_link(rest);
+        mark_written(pw, rest + 1);
+    } else {
+        *link = fb->next;
+        mark_written(pw, (void *)fb + size);
+    }
+    return fb;
+}
+
+
+// put size bytes at ptr back on the map, merging with both neighbours
+static void give_block(page_wrapper_t *pw, void *ptr, kma_size_t size) {
+    free_block_t *prev = NULL;
+    free_block_t *next = FB(pw->fb_head);
+    while (next && (void *)next < ptr) {
+        prev = next;
+        next = FB(next->next);
+    }
+    free_block_t *fb = ptr;
+    fb->next = kma_link(next);
+    fb->size = size;
+    if (next && ptr + size == (void *)next) {
+        fb->next = next->next;
+        fb->size += next->size;
+    }
+    if (!prev) {
+        pw->fb_head = kma_link(fb);
+    } else if ((void *)prev + prev->size == ptr) {
+        prev->next = fb->next;
+        prev->size += fb->size;
+    } else {
+        prev->next = kma_link(fb);
+    }
+}
+
+
+// hand out size bytes from the free block *link, and how many of them
+// may not be zero
+static void *carve(page_wrapper_t *pw, kma_link_t *link, kma_size_t size, kma_size_t *dirty) {
+    void *ptr = FB(*link);
+    *dirty = pw->clean <= ptr ? 0 : pw->clean >= ptr + size ? size : pw->clean - ptr;
+    return take_block(pw, link, ROUND(size));
+}
+
+
+// first fit on the pages of list other than skip, NULL if none has room
+static void *fit(page_list_t *list, page_wrapper_t *skip, kma_size_t size, kma_size_t *dirty) {
+    page_wrapper_t *pw;
+    for (pw = list->head; pw; pw = pw->next) {
+        kma_link_t *link;
+        if (pw == skip) {
+            continue;
+        }
+        for (link = &pw->fb_head; *link; link = &FB(*link)->next) {
+            if (FB(*link)->size >= ROUND(size)) {
+                return carve(pw, link, size, dirty);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+// first fit on the pages of list, or the start of a new one; NULL if
+// the pool has none
+static void *place(page_list_t *list, kma_size_t size, kma_size_t *dirty) {
+    void *ptr = fit(list, NULL, size, dirty);
+    if (!ptr) {
+        page_wrapper_t *pw = new_page(list);
+        ptr = pw ? carve(pw, &pw->fb_head, size, dirty) : NULL;
+    }
+    return ptr;
+}
+
+static void *rm_calloc(kma_size_t size, kma_size_t *dirty) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    return place(&blocks, size, dirty);
+}
+
+static void *rm_malloc(kma_size_t size) {
+    kma_size_t dirty;
+    return rm_calloc(size, &dirty);
+}
+
+static void rm_free(void* ptr, kma_size_t size) {
+    page_wrapper_t *pw = page_stat + page_index(ptr);
+    give_block(pw, ptr, ROUND(size));
+    if (FB(pw->fb_head)->size == pw->page->size) {
+        release_page(pw);
+    }
+}
+
+static bool rm_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (new_size <= 0 || new_size > PAGESIZE) {
+        return FALSE;
+    }
+    page_wrapper_t *pw = page_stat + page_index(ptr);
+    kma_size_t from = ROUND(old_size);
+    kma_size_t to = ROUND(new_size);
+    if (to < from) {
+        give_block(pw, ptr + to, from - to);
+        return TRUE;
+    }
+    if (to == from) {
+        return TRUE;
+    }
+    // grow into the free block that starts where this one ends
+    kma_link_t *link = &pw->fb_head;
+    while (*link && (void *)FB(*link) < ptr + from) {
+        link = &FB(*link)->next;
+    }
+    if ((void *)FB(*link) != ptr + from || FB(*link)->size < to - from) {
+        return FALSE;
+    }
+    take_block(pw, link, to - from);
+    return TRUE;
+}
+
+// first fit for a free block with an aligned start inside it; the part
+// in front of that start is split off and stays free
+static void *rm_memalign(kma_size_t align, kma_size_t size) {
+    if (align <= ALIGN) {
+        return rm_malloc(size);
+    }
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    kma_size_t dirty;
+    page_wrapper_t *pw;
+    for (pw = blocks.head; pw; pw = pw->next) {
+        kma_link_t *link;
+        for (link = &pw->fb_head; *link; link = &FB(*link)->next) {
+            free_block_t *fb = FB(*link);
+            void *start = (void *)(((long)fb + align - 1) & ~(long)(align - 1));
+            if (start + ROUND(size) > (void *)fb + fb->size) {
+                continue;
+            }
+            if (start != (void *)fb) {
+                free_block_t *rest = start;
+                rest->next = fb->next;
+                rest->size = fb->size - (start - (void *)fb);
+                fb->next = kma_link(rest);
+                fb->size = start - (void *)fb;
+                mark_written(pw, rest + 1);
+                link = &fb->next;
+            }
+            return carve(pw, link, size, &dirty);
+        }
+    }
+    // a page start is aligned to anything
+    pw = new_page(&blocks);
+    return pw ? carve(pw, &pw->fb_head, size, &dirty) : NULL;
+}
 
 
+static handle_t *entry(kma_handle_t h) {
+    return (handle_t *)table[h / HANDLES_PER_PAGE]->ptr + h % HANDLES_PER_PAGE;
+}
+
 
-void *kma_malloc(kma_size_t size) {
-    if (!page_head && !free_head) {
-        free_head = page_stat;
-        (page_stat[MAXPAGES - 1]).next = NULL;
+static kma_handle_t new_handle() {
+    kma_handle_t h = free_handles;
+    if (h) {
+        free_handles = entry(h)->next;
+    } else {
+        if (n_handles % HANDLES_PER_PAGE == 0) {
+            table[n_handles / HANDLES_PER_PAGE] = get_page();
+            // KMA_NO_HANDLE is never given out
+            n_handles += !n_handles;
+        }
+        h = n_handles++;
+    }
+    live_handles++;
+    return h;
+}
+
+
+// the table pages go back with the last handle
+static void release_handle(kma_handle_t h) {
+    entry(h)->next = free_handles;
+    free_handles = h;
+    if (--live_handles == 0) {
         int i;
-        for (i = 0; i < MAXPAGES - 1; i++) {
-            (page_stat[i]).next = page_stat + i + 1;
+        for (i = 0; i * HANDLES_PER_PAGE < n_handles; i++) {
+            free_page(table[i]);
         }
+        n_handles = 0;
+        free_handles = KMA_NO_HANDLE;
     }
-    if (!page_head) {
-        page_head = free_head;
-        free_head = free_head->next;
-        kma_page_t *page = get_page();
-        *((void **)page->ptr) = NULL;
-        *((kma_size_t *)(page->ptr + PTRSIZE)) = page->size - PTRSIZE - INTSIZE;
-        page_head->page = page;
-        page_head->fb_head = page->ptr;
-        page_head->next = NULL;
-    }
-    page_wrapper_t *page_pre = NULL;
-    page_wrapper_t *page_cur = page_head;
-    while (page_cur) {
-        void *fb_pre = NULL;
-        void *fb_cur = page_cur->fb_head;
-        while (fb_cur) {
-            if (*((kma_size_t *)(fb_cur + PTRSIZE)) >= size) {
-                void *space = fb_cur;
-                fb_cur += size;
-                *((void **)fb_cur) = *((void **)space);
-                *((kma_size_t *)(fb_cur + PTRSIZE)) = *((kma_size_t *)(space + PTRSIZE)) - size;
-                if (fb_pre == NULL) {
-                    page_cur->fb_head = fb_cur;
-                } else {
-                    *((void **)fb_pre) = fb_cur;
-                }
-                return space;
+}
+
+
+// puts the block of h at ptr, with room for size bytes
+static void attach(kma_handle_t h, void *ptr, kma_size_t size) {
+    handle_t *e = entry(h);
+    page_wrapper_t *pw = page_stat + page_index(ptr);
+    e->ptr = kma_link(ptr);
+    e->size = size;
+    e->next = pw->handles;
+    pw->handles = h;
+    pw->live += ROUND(size);
+    pw->list->live += ROUND(size);
+}
+
+
+// gives the block of h back to its page, and the page back once empty
+static void detach(kma_handle_t h) {
+    handle_t *e = entry(h);
+    page_wrapper_t *pw = page_stat + page_index(kma_ptr(e->ptr));
+    kma_handle_t *link = &pw->handles;
+    while (*link != h) {
+        link = &entry(*link)->next;
+    }
+    *link = e->next;
+    pw->live -= ROUND(e->size);
+    pw->list->live -= ROUND(e->size);
+    pw->pinned -= e->pins;
+    rm_free(kma_ptr(e->ptr), e->size);
+}
+
+
+// copies the unpinned block of h to ptr, which has room for size bytes
+static void relocate(kma_handle_t h, void *ptr, kma_size_t size) {
+    handle_t *e = entry(h);
+    memcpy(ptr, kma_ptr(e->ptr), e->size < size ? e->size : size);
+    detach(h);
+    attach(h, ptr, size);
+}
+
+
+kma_handle_t kma_halloc(kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return KMA_NO_HANDLE;
+    }
+    kma_size_t dirty;
+    void *ptr = place(&movable, size, &dirty);
+    if (!ptr) {
+        return KMA_NO_HANDLE;
+    }
+    kma_handle_t h = new_handle();
+    attach(h, ptr, size);
+    entry(h)->pins = 0;
+    return h;
+}
+
+
+void kma_hfree(kma_handle_t h) {
+    detach(h);
+    release_handle(h);
+}
+
+
+bool kma_hrealloc(kma_handle_t h, kma_size_t new_size) {
+    if (new_size <= 0 || new_size > PAGESIZE) {
+        return FALSE;
+    }
+    handle_t *e = entry(h);
+    page_wrapper_t *pw = page_stat + page_index(kma_ptr(e->ptr));
+    kma_size_t dirty;
+    if (rm_resize(kma_ptr(e->ptr), e->size, new_size)) {
+        pw->live += ROUND(new_size) - ROUND(e->size);
+        movable.live += ROUND(new_size) - ROUND(e->size);
+        e->size = new_size;
+        return TRUE;
+    }
+    void *ptr = e->pins ? NULL : place(&movable, new_size, &dirty);
+    if (!ptr) {
+        return FALSE;
+    }
+    relocate(h, ptr, new_size);
+    return TRUE;
+}
+
+
+void *kma_pin(kma_handle_t h) {
+    handle_t *e = entry(h);
+    e->pins++;
+    page_stat[page_index(kma_ptr(e->ptr))].pinned++;
+    return kma_ptr(e->ptr);
+}
+
+
+void kma_unpin(kma_handle_t h) {
+    handle_t *e = entry(h);
+    e->pins--;
+    page_stat[page_index(kma_ptr(e->ptr))].pinned--;
+}
+
+
+int kma_compact(int moves) {
+    int released = 0;
+    // a page whose blocks fit on the others leaves at least a page free
+    while (moves > 0 && (long) movable.pages * PAGESIZE - movable.live >= PAGESIZE) {
+        page_wrapper_t *src = NULL, *pw;
+        for (pw = movable.head; pw; pw = pw->next) {
+            if (!pw->pinned && (!src || pw->live < src->live)) {
+                src = pw;
+            }
+        }
+        // only a sparse page whose blocks the other pages have room for
+        if (!src || src->live > SPARSE
+            || (long)(movable.pages - 1) * PAGESIZE - (movable.live - src->live) < src->live) {
+            break;
+        }
+        int pages = movable.pages;
+        while (movable.pages == pages && moves > 0) {
+            handle_t *e = entry(src->handles);
+            kma_size_t dirty;
+            void *ptr = fit(&movable, src, e->size, &dirty);
+            if (!ptr) {
+                return released;
             }
-            fb_pre = fb_cur;
-            fb_cur = *((void **)fb_cur);
+            relocate(src->handles, ptr, e->size);
+            kma_compact_moves++;
+            moves--;
         }
-        page_pre = page_cur;
-        page_cur = page_cur->next;
-    }
-    page_cur = free_head;
-    free_head = free_head->next;
-    page_pre->next = page_cur;
-    kma_page_t *page = get_page();
-    page_cur->page = page;
-    page_cur->next = NULL;
-    *((void **)(page->ptr + size)) = NULL;
-    *((kma_size_t *)(page->ptr + size + PTRSIZE)) = page->size - size - PTRSIZE - INTSIZE;
-    page_cur->fb_head = page->ptr + size;
-    return page->ptr;
-}
-
-void kma_free(void* ptr, kma_size_t size) {
-    page_wrapper_t *page_pre = NULL;
-    page_wrapper_t *page_cur = page_head;
-    while (page_cur) {
-        if (page_cur->page->ptr <= ptr && ptr + size <= page_cur->page->ptr + page_cur->page->size) {
-            void *fb_pre = NULL;
-            void *fb_cur = page_cur->fb_head;
-            while (fb_cur) {
-                if (ptr < fb_cur) {
-                    if (!fb_pre) {
-                        if (ptr + size == fb_cur) {
-                            void *space = fb_cur;
-                            fb_cur = ptr;
-                            *((void **)fb_cur) = *((void **)space);
-                            *((kma_size_t *)(fb_cur + PTRSIZE)) = *((kma_size_t *)(space + PTRSIZE)) + size;
-                        } else {
-                            *((void **)ptr) = fb_cur;
-                            *((kma_size_t *)(ptr + PTRSIZE)) = size - PTRSIZE - INTSIZE;
-                        }
-                        page_cur->fb_head = ptr;
-                    } else {
-                        if (fb_cur - fb_pre - *((kma_size_t *)(fb_pre + PTRSIZE)) - PTRSIZE - INTSIZE == size) {
-                            *((void **)fb_pre) = *((void **)fb_cur);
-                            *((kma_size_t *)(fb_pre + PTRSIZE)) += size + *((kma_size_t *)(fb_cur + PTRSIZE)) + PTRSIZE + INTSIZE;
-                        } else if (ptr + size == fb_cur) {
-                            void *space = fb_cur;
-                            fb_cur = ptr;
-                            *((void **)fb_cur) = *((void **)space);
-                            *((kma_size_t *)(fb_cur + PTRSIZE)) = *((kma_size_t *)(space + PTRSIZE)) + size;
-                            *((void **)fb_pre) = fb_cur;
-                        } else if (ptr == fb_pre + PTRSIZE + INTSIZE + *((kma_size_t *)(fb_pre + PTRSIZE))) {
-                            *((kma_size_t *)(fb_pre + PTRSIZE)) += size;
-                        } else {
-                            *((void **)ptr) = fb_cur;
-                            *((kma_size_t *)(ptr + PTRSIZE)) = size - PTRSIZE - INTSIZE;
-                            *((void **)fb_pre) = ptr;
-                        }
-                    }
-                    if (page_cur->fb_head == page_cur->page->ptr && *((kma_size_t *)(page_cur->fb_head + PTRSIZE)) + PTRSIZE + INTSIZE == page_cur->page->size) {
-                        if (!page_pre) {
-                            page_head = page_cur->next;
-                        } else {
-                            page_pre->next = page_cur->next;
-                        }
-                        free_page(page_cur->page);
-                        page_cur->next = free_head;
-                        free_head = page_cur;
-                    }
-                    return;
+        if (movable.pages < pages) {
+            kma_compact_released++;
+            released++;
+        }
+    }
+    return released;
+}
+
+static long rm_save(void *image, long room) {
+    page_list_t *lists[2] = {&blocks, &movable};
+    rm_image_t *im = image;
+    page_image_t *pi = image + sizeof(rm_image_t);
+    page_wrapper_t *pw;
+    int l, i;
+    long size = sizeof(rm_image_t) + (long)(blocks.pages + movable.pages) * sizeof(page_image_t);
+    if (room < size) {
+        return -1;
+    }
+    // a pinned block is in use where it is
+    for (pw = movable.head; pw; pw = pw->next) {
+        if (pw->pinned) {
+            return -1;
+        }
+    }
+    im->pool = (long) kma_pool;
+    for (l = 0; l < 2; l++) {
+        im->pages[l] = lists[l]->pages;
+        im->live[l] = lists[l]->live;
+        for (pw = lists[l]->head; pw; pw = pw->next, pi++) {
+            pi->index = page_index(pw->page->ptr);
+            pi->fb_head = pw->fb_head ? kma_ptr(pw->fb_head) - kma_pool : -1;
+            pi->clean = pw->clean - pw->page->ptr;
+            pi->handles = pw->handles;
+            pi->live = pw->live;
+        }
+        lists[l]->head = lists[l]->tail = NULL;
+        lists[l]->pages = 0;
+        lists[l]->live = 0;
+    }
+    im->n_handles = n_handles;
+    im->live_handles = live_handles;
+    im->free_handles = free_handles;
+    for (i = 0; i * HANDLES_PER_PAGE < n_handles; i++) {
+        im->table[i] = page_index(table[i]->ptr);
+    }
+    n_handles = 0;
+    live_handles = 0;
+    free_handles = KMA_NO_HANDLE;
+    return size;
+}
+
+static bool rm_restore(void *image, long size) {
+    page_list_t *lists[2] = {&blocks, &movable};
+    rm_image_t *im = image;
+    page_image_t *pi = image + sizeof(rm_image_t);
+    int l, i;
+    if (size < (long) sizeof(rm_image_t)
+        || size != sizeof(rm_image_t) + (long)(im->pages[0] + im->pages[1]) * sizeof(page_image_t)) {
+        return FALSE;
+    }
+    n_handles = im->n_handles;
+    live_handles = im->live_handles;
+    free_handles = im->free_handles;
+    for (i = 0; i * HANDLES_PER_PAGE < n_handles; i++) {
+        table[i] = page_of(kma_pool + (long) im->table[i] * PAGESIZE);
+    }
+    for (l = 0; l < 2; l++) {
+        page_list_t *list = lists[l];
+        for (i = 0; i < im->pages[l]; i++, pi++) {
+            page_wrapper_t *pw = page_stat + pi->index;
+            pw->page = page_of(kma_pool + (long) pi->index * PAGESIZE);
+            pw->fb_head = kma_link(pi->fb_head < 0 ? NULL : kma_pool + pi->fb_head);
+            pw->clean = pw->page->ptr + pi->clean;
+            pw->list = list;
+            pw->prev = list->tail;
+            pw->next = NULL;
+            pw->live = pi->live;
+            pw->pinned = 0;
+            pw->handles = pi->handles;
+            if (list->tail) {
+                list->tail->next = pw;
+            } else {
+                list->head = pw;
+            }
+            list->tail = pw;
+            list->pages++;
+#ifndef KMA_LINK32
+            long delta = kma_pool - (void *) im->pool;
+            if (delta) {
+                free_block_t *fb;
+                kma_handle_t h;
+                for (fb = FB(pw->fb_head); fb && fb->next; fb = FB(fb->next)) {
+                    fb->next += delta;
+                }
+                for (h = pw->handles; h; h = entry(h)->next) {
+                    entry(h)->ptr += delta;
                 }
-                fb_pre = fb_cur;
-                fb_cur = *((void **)fb_cur);
             }
+#endif
         }
-        page_pre = page_cur;
-        page_cur = page_cur->next;
+        list->live = im->live[l];
     }
+    return TRUE;
 }
 
-#endif // KMA_RM
\ No newline at end of file
+kma_backend_t kma_rm_backend = {
+    .name = "rm",
+    .malloc = rm_malloc,
+    .free = rm_free,
+    .resize = rm_resize,
+    .calloc = rm_calloc,
+    .memalign = rm_memalign,
+    .save = rm_save,
+    .restore = rm_restore
+};
@@ -0,0 +1,432 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Sampling heap profiler: live blocks by allocation site
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#define __KMA_IMPL__
+#define __KMA_SAMPLE_IMPL__
+
+/************System include***********************************************/
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_sample.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// an allocation site: a stack, with the samples live now and at the
+// last snapshot, their bytes, and the bytes they stand for
+typedef struct site_t {
+    unsigned long hash;
+    int depth;
+    void *stack[KMA_SAMPLE_DEPTH];
+    int count;
+    long bytes;
+    long weight;
+    int peak_count;
+    long peak_bytes;
+    long peak_weight;
+} site_t;
+
+// a live sample
+typedef struct sample_t {
+    void *ptr;
+    kma_size_t size;
+    long weight;
+    int site;
+} sample_t;
+
+/************Global Variables*********************************************/
+
+__thread long kma_sample_left = 0;
+
+int kma_sample_live = 0;
+
+int kma_sample_taken = 0;
+
+int kma_sample_dropped = 0;
+
+unsigned short kma_sample_pages[MAXPAGES];
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+/*
+ * Both tables are open addressed with twice the slots they may fill.
+ * Samples are found by their block and leave no tombstones: the ones
+ * after a freed slot are shifted back. Sites are never removed, and
+ * are found by the hash of their stack through an index of site + 1.
+ */
+#define SAMPLE_SLOTS (2 * KMA_SAMPLE_LIVE)
+#define SITE_SLOTS (2 * KMA_SAMPLE_SITES)
+
+static sample_t samples[SAMPLE_SLOTS];
+
+static site_t sites[KMA_SAMPLE_SITES];
+static short site_slots[SITE_SLOTS];
+static int n_sites = 0;
+
+// the mean interval, the last that was not 0 for the profile header,
+// and the random state
+static long rate = 0;
+static long last_rate = 0;
+static unsigned long seed = 0x2545f4914f6cdd1dUL;
+
+// per thread: whether an interval runs, and how long it was
+static __thread int started = 0;
+static __thread long interval = 0;
+
+// backtrace() may allocate the first time, which must not sample again
+static __thread int busy = 0;
+
+#ifdef KMA_SAMPLE_FP
+// the end of the thread's stack, for walk()
+static __thread char *stack_top = NULL;
+#endif
+
+
+
+// xorshift64*
+static unsigned long next_random() {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 0x2545f4914f6cdd1dUL;
+}
+
+
+// an exponential interval with a mean of rate bytes, -ln u for u
+// uniform in (0, 1] times rate, without libm: for u = m / 2^e with m in
+// [1, 2), ln u = ln m - e ln 2, and ln m = 2 atanh((m - 1) / (m + 1))
+static long next_interval() {
+    double u = ((next_random() >> 11) + 1) / 9007199254740992.0;
+    int e = 0;
+
+    while (u < 1) {
+        u *= 2;
+        e++;
+    }
+    double s = (u - 1) / (u + 1), s2 = s * s;
+    double ln_m = 2 * s * (1 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 / 9))));
+    long length = (e * 0.6931471805599453 - ln_m) * rate;
+    return length > 0 ? length : 1;
+}
+
+
+// with sampling off, the thread looks at the rate again after
+// KMA_SAMPLE_RECHECK bytes, so that one set meanwhile reaches it
+static void start() {
+    started = 1;
+    interval = rate ? next_interval() : KMA_SAMPLE_RECHECK;
+    kma_sample_left = interval;
+}
+
+
+void kma_sample(long bytes) {
+    pthread_mutex_lock(&kma_page_lock);
+    rate = bytes > 0 ? bytes : 0;
+    if (rate) {
+        last_rate = rate;
+    }
+    start();
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+/*
+ * backtrace() unwinds with the tables of each object, which works for
+ * any code but takes microseconds. Built with -DKMA_SAMPLE_FP and
+ * -fno-omit-frame-pointer, the stack comes from walk() instead, which
+ * follows the frame pointers in tens of nanoseconds, as long as the
+ * callers keep them too. Either way the first frame is that of the
+ * caller of the walk.
+ */
+#ifdef KMA_SAMPLE_FP
+static __attribute__((noinline)) int walk(void **stack, int depth) {
+    void **fp = __builtin_frame_address(0);
+    int n = 0;
+
+    if (!stack_top) {
+        pthread_attr_t attr;
+        void *base;
+        size_t size;
+        stack_top = (char *) fp;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if (pthread_attr_getstack(&attr, &base, &size) == 0) {
+                stack_top = (char *) base + size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+    // each frame is the frame pointer of the caller, then the return
+    // address; the chain ends where it leaves the stack or goes down
+    while (n < depth && (char *) (fp + 2) <= stack_top) {
+        void **next = fp[0];
+        stack[n++] = fp[1];
+        if (next <= fp || ((unsigned long) next & (sizeof(void *) - 1))) {
+            break;
+        }
+        fp = next;
+    }
+    return n;
+}
+#else
+#define walk backtrace
+#endif
+
+
+static unsigned long slot_of(void *ptr) {
+    return ((unsigned long) ptr >> 3) * 0x9e3779b97f4a7c15UL >> 32;
+}
+
+
+static unsigned long hash_of(void **stack, int depth) {
+    unsigned long hash = depth;
+    int i;
+
+    for (i = 0; i < depth; i++) {
+        hash = (hash ^ (unsigned long) stack[i]) * 0x100000001b3UL;
+    }
+    return hash;
+}
+
+
+// the site of a stack, added if it is new; -1 if there is no room
+static int site_of(void **stack, int depth) {
+    unsigned long hash = hash_of(stack, depth);
+    unsigned long i;
+
+    for (i = hash % SITE_SLOTS; site_slots[i]; i = (i + 1) % SITE_SLOTS) {
+        site_t *site = &sites[site_slots[i] - 1];
+        if (site->hash == hash && site->depth == depth
+            && memcmp(site->stack, stack, depth * sizeof(void *)) == 0) {
+            return site_slots[i] - 1;
+        }
+    }
+    if (n_sites == KMA_SAMPLE_SITES) {
+        return -1;
+    }
+    site_t *site = &sites[n_sites];
+    memset(site, 0, sizeof(site_t));
+    site->hash = hash;
+    site->depth = depth;
+    memcpy(site->stack, stack, depth * sizeof(void *));
+    site_slots[i] = ++n_sites;
+    return n_sites - 1;
+}
+
+
+// the interval that ran out, with the bytes of the block past its end,
+// is the weight of the sample
+static void *take(void *ptr, kma_size_t size) {
+    long weight = interval - kma_sample_left;
+    void *stack[KMA_SAMPLE_DEPTH + 1];
+
+    if (!started || !rate) {
+        start();
+        return ptr;
+    }
+    start();
+    if (!ptr || busy) {
+        return ptr;
+    }
+    kma_sample_taken++;
+    if (kma_sample_live == KMA_SAMPLE_LIVE) {
+        kma_sample_dropped++;
+        return ptr;
+    }
+
+    // the first frame is this function's own
+    busy = 1;
+    int depth = walk(stack, KMA_SAMPLE_DEPTH + 1) - 1;
+    busy = 0;
+    int site = site_of(stack + 1, depth > 0 ? depth : 0);
+    if (site < 0) {
+        kma_sample_dropped++;
+        return ptr;
+    }
+
+    unsigned long i;
+    for (i = slot_of(ptr) % SAMPLE_SLOTS; samples[i].ptr; i = (i + 1) % SAMPLE_SLOTS) {
+    }
+    samples[i].ptr = ptr;
+    samples[i].size = size;
+    samples[i].weight = weight;
+    samples[i].site = site;
+    sites[site].count++;
+    sites[site].bytes += size;
+    sites[site].weight += weight;
+    if (page_contains(ptr)) {
+        kma_sample_pages[page_index(ptr)]++;
+    }
+    kma_sample_live++;
+    return ptr;
+}
+
+
+static void drop(void *ptr) {
+    unsigned long i, j, home;
+
+    for (i = slot_of(ptr) % SAMPLE_SLOTS; samples[i].ptr != ptr; i = (i + 1) % SAMPLE_SLOTS) {
+        if (!samples[i].ptr) {
+            return;
+        }
+    }
+    site_t *site = &sites[samples[i].site];
+    site->count--;
+    site->bytes -= samples[i].size;
+    site->weight -= samples[i].weight;
+    if (page_contains(ptr)) {
+        kma_sample_pages[page_index(ptr)]--;
+    }
+    kma_sample_live--;
+
+    // shift back each sample after the hole that may not be reached
+    // from its home slot past it
+    for (j = (i + 1) % SAMPLE_SLOTS; samples[j].ptr; j = (j + 1) % SAMPLE_SLOTS) {
+        home = slot_of(samples[j].ptr) % SAMPLE_SLOTS;
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            samples[i] = samples[j];
+            i = j;
+        }
+    }
+    samples[i].ptr = NULL;
+}
+
+
+// the tables are shared by all threads, which take them with the page
+// layer's lock
+void *kma_sample_take(void *ptr, kma_size_t size) {
+    pthread_mutex_lock(&kma_page_lock);
+    ptr = take(ptr, size);
+    pthread_mutex_unlock(&kma_page_lock);
+    return ptr;
+}
+
+
+void kma_sample_drop(void *ptr) {
+    pthread_mutex_lock(&kma_page_lock);
+    drop(ptr);
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+long kma_sample_snapshot() {
+    long weight = 0;
+    int i;
+
+    pthread_mutex_lock(&kma_page_lock);
+    for (i = 0; i < n_sites; i++) {
+        sites[i].peak_count = sites[i].count;
+        sites[i].peak_bytes = sites[i].bytes;
+        sites[i].peak_weight = sites[i].weight;
+        weight += sites[i].weight;
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+    return weight;
+}
+
+
+// a frame as its function, or its object and offset when the function
+// is not exported; the return address is looked up one byte back, in
+// the call
+static void put_frame(FILE *f, void *address) {
+    Dl_info info;
+    int found = dladdr((char *) address - 1, &info);
+
+    if (found && info.dli_sname) {
+        fprintf(f, "%s", info.dli_sname);
+    } else if (found && info.dli_fname) {
+        char *base = strrchr(info.dli_fname, '/');
+        fprintf(f, "%s+0x%lx", base ? base + 1 : info.dli_fname,
+                (unsigned long) ((char *) address - (char *) info.dli_fbase));
+    } else {
+        fprintf(f, "%p", address);
+    }
+}
+
+
+/*
+ * The pprof profile is a gperftools heap profile: in-use samples and
+ * bytes per stack, which pprof scales up by heap_v2/rate itself, with
+ * the mappings it needs to find the symbols. Only live samples are
+ * kept, so the allocation totals are 0. The folded stacks have the
+ * root first and the bytes the samples stand for last.
+ */
+int kma_sample_dump(char *file, int format, bool peak) {
+    FILE *f = fopen(file, "w");
+    int count = 0, written = 0, i, j;
+    long bytes = 0;
+
+    if (!f) {
+        return -1;
+    }
+    pthread_mutex_lock(&kma_page_lock);
+    for (i = 0; i < n_sites; i++) {
+        count += peak ? sites[i].peak_count : sites[i].count;
+        bytes += peak ? sites[i].peak_bytes : sites[i].bytes;
+    }
+    if (format == KMA_SAMPLE_PPROF) {
+        fprintf(f, "heap profile: %6d: %8ld [%6d: %8ld] @ heap_v2/%ld\n", count, bytes, 0, 0L, last_rate);
+    }
+    for (i = 0; i < n_sites; i++) {
+        site_t *site = &sites[i];
+        if (!(peak ? site->peak_count : site->count)) {
+            continue;
+        }
+        if (format == KMA_SAMPLE_PPROF) {
+            fprintf(f, "%6d: %8ld [%6d: %8ld] @", peak ? site->peak_count : site->count,
+                    peak ? site->peak_bytes : site->bytes, 0, 0L);
+            for (j = 0; j < site->depth; j++) {
+                fprintf(f, " %p", site->stack[j]);
+            }
+        } else {
+            for (j = site->depth - 1; j >= 0; j--) {
+                put_frame(f, site->stack[j]);
+                if (j) {
+                    fputc(';', f);
+                }
+            }
+            fprintf(f, " %ld", peak ? site->peak_weight : site->weight);
+        }
+        fprintf(f, "\n");
+        written++;
+    }
+    if (format == KMA_SAMPLE_PPROF) {
+        FILE *maps = fopen("/proc/self/maps", "r");
+        char line[512];
+        fprintf(f, "\nMAPPED_LIBRARIES:\n");
+        while (maps && fgets(line, sizeof(line), maps)) {
+            fputs(line, f);
+        }
+        if (maps) {
+            fclose(maps);
+        }
+    }
+    pthread_mutex_unlock(&kma_page_lock);
+    fclose(f);
+    return written;
+}
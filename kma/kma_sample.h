@@ -0,0 +1,161 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Sampling heap profiler: live blocks by allocation site
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_SAMPLE_H__
+#define __KMA_SAMPLE_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+#include "kma_page.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_SAMPLE_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/*
+ * With sampling on, kma_malloc() and the others count the bytes they
+ * hand out, and the block in which a random interval of on average
+ * rate bytes runs out is sampled: its stack of up to KMA_SAMPLE_DEPTH
+ * return addresses is taken, with backtrace() or, built with
+ * -DKMA_SAMPLE_FP, the frame pointers, and the block is kept in a
+ * table of live samples until it is freed. A sample stands for the
+ * bytes of the interval it ended, so the table estimates live bytes by
+ * allocation site, now or at the peak kma_sample_snapshot() last saw.
+ * Up to KMA_SAMPLE_LIVE samples from KMA_SAMPLE_SITES different stacks
+ * are kept; those past either are counted as dropped. Each thread
+ * counts its own bytes, so that with sampling off no allocation writes
+ * shared memory; the tables are shared, under kma_page_lock. With
+ * sampling off, a thread still stops every KMA_SAMPLE_RECHECK bytes to
+ * read the rate, which is how a rate set by another thread reaches it.
+ */
+#define KMA_SAMPLE_DEPTH 24
+#define KMA_SAMPLE_LIVE 8192
+#define KMA_SAMPLE_SITES 1024
+#define KMA_SAMPLE_RECHECK (1L << 20)
+
+// the formats of kma_sample_dump(): a legacy pprof heap profile, which
+// pprof reads with the binary, and folded stacks, one line per site,
+// for flame graphs
+#define KMA_SAMPLE_PPROF 0
+#define KMA_SAMPLE_FOLDED 1
+
+/************Global Variables*********************************************/
+
+// bytes the calling thread has left until its next sample; it starts
+// at 0, so a thread's first allocation reads the rate
+EXTERN __thread long kma_sample_left;
+
+// samples now live, those taken in all, and those not kept for want of
+// room
+EXTERN int kma_sample_live;
+
+EXTERN int kma_sample_taken;
+
+EXTERN int kma_sample_dropped;
+
+// live samples in each page of the pool, so that kma_free() only
+// looks up blocks that may be sampled
+EXTERN unsigned short kma_sample_pages[MAXPAGES];
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Sets the sampling rate
+ * ---------------------------------------------------------------------
+ *    Purpose: Samples a block about every rate bytes allocated from now
+ *             on, or stops sampling; the samples taken so far stay
+ *             until their blocks are freed. Other threads follow after
+ *             at most KMA_SAMPLE_RECHECK bytes of their own
+ *    Input: the mean bytes between samples, 0 for none
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_sample(long rate);
+
+/***********************************************************************
+ *  Title: Takes a sample
+ * ---------------------------------------------------------------------
+ *    Purpose: Starts the next interval, and keeps the block that ended
+ *             this one with the stack of its caller
+ *    Input: the block, or NULL if the allocation failed, its size
+ *    Output: the block
+ ***********************************************************************/
+EXTERN void *kma_sample_take(void *ptr, kma_size_t size);
+
+/***********************************************************************
+ *  Title: Drops a sample
+ * ---------------------------------------------------------------------
+ *    Purpose: Forgets a freed block, if it was sampled
+ *    Input: the block
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_sample_drop(void *ptr);
+
+/***********************************************************************
+ *  Title: Saves the peak
+ * ---------------------------------------------------------------------
+ *    Purpose: Keeps what is live now by site, for kma_sample_dump() of
+ *             the peak
+ *    Input: none
+ *    Output: the live bytes the samples stand for
+ ***********************************************************************/
+EXTERN long kma_sample_snapshot();
+
+/***********************************************************************
+ *  Title: Writes a profile
+ * ---------------------------------------------------------------------
+ *    Purpose: Writes the live samples, or those of the last snapshot,
+ *             by site to file in one of the KMA_SAMPLE_XXX formats
+ *    Input: the path, the format, TRUE for the snapshot
+ *    Output: the sites written, or -1 if the file could not be
+ ***********************************************************************/
+EXTERN int kma_sample_dump(char *file, int format, bool peak);
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+// counts size bytes against the interval; TRUE if the block of them is
+// to be sampled. kma_malloc() asks before it allocates, so that the
+// backend's malloc stays a tail call
+static inline bool kma_sample_due(kma_size_t size) {
+    return (kma_sample_left -= size) < 0;
+}
+
+// what the others do with each block they hand out
+static inline void *kma_sample_malloc(void *ptr, kma_size_t size) {
+    return kma_sample_due(size) ? kma_sample_take(ptr, size) : ptr;
+}
+
+// and kma_free() and the others with each block they take back
+static inline void kma_sample_free(void *ptr) {
+    if (kma_sample_live) {
+        unsigned long offset = (char *) ptr - (char *) kma_pool;
+        if (offset >= (unsigned long) MAXPAGES * PAGESIZE || kma_sample_pages[offset / PAGESIZE]) {
+            kma_sample_drop(ptr);
+        }
+    }
+}
+
+#endif /* __KMA_SAMPLE_H__ */
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Cost of heap sampling on kma_malloc/kma_free, off and on
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_sample.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// blocks live at once; each step frees one at random and allocates
+// another in its place, of 16 to 4096 bytes, smaller ones more often
+#define LIVE 4096
+#define STEPS 1000000
+// rounds of one run of each kind, taken in turn so that they share
+// what else the machine does; the fastest run of each counts
+#define REPS 15
+// 64-byte blocks a second thread allocates once the rate is set
+#define CROSS_STEPS 200000
+
+/************Global Variables*********************************************/
+
+static kma_size_t sizes[STEPS];
+
+static int slots[STEPS];
+
+static void *ptrs[LIVE];
+
+static kma_size_t live[LIVE];
+
+static pthread_barrier_t barrier;
+
+/************Function Prototypes******************************************/
+void error(char *, char *);
+
+double now();
+
+double churn(long rate, int direct);
+
+double best(double sofar, double ns);
+
+int cross(long rate);
+
+void *worker(void *);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    long rate = argc > 1 ? atol(argv[1]) : 524288;
+    kma_backend_t **b;
+    int i, r, failed = 0;
+
+    if (rate <= 0) {
+        printf("Usage: %s [rate] [backend...]\n", argv[0]);
+        exit(0);
+    }
+    srand(1);
+    for (i = 0; i < STEPS; i++) {
+        sizes[i] = 16 << (rand() % 9);
+        sizes[i] += rand() % sizes[i];
+        if (sizes[i] > 4096) {
+            sizes[i] = 4096;
+        }
+        slots[i] = rand() % LIVE;
+    }
+
+    printf("%8s %10s %10s %10s %8s %8s\n", "backend", "hook ns", "off ns", "on ns", "off", "on");
+    for (b = kma_backends; *b; b++) {
+        if (argc > 2) {
+            for (i = 2; i < argc && kma_backend_find(argv[i]) != *b; i++) {
+            }
+            if (i == argc) {
+                continue;
+            }
+        }
+        kma_current = *b;
+        double hook = -1, off = -1, on = -1;
+        for (r = 0; r < REPS; r++) {
+            hook = best(hook, churn(0, 1));
+            off = best(off, churn(0, 0));
+            on = best(on, churn(rate, 0));
+        }
+        printf("%8s %10.1f %10.1f %10.1f %+7.1f%% %+7.1f%%\n", (*b)->name, hook, off, on,
+               (off / hook - 1) * 100, (on / hook - 1) * 100);
+        if (page_stats()->num_in_use || kma_sample_live) {
+            printf("%8s: not all pages freed or samples dropped\n", (*b)->name);
+            failed = 1;
+        }
+    }
+    printf("rate %ld: %d samples taken, %d dropped\n", rate, kma_sample_taken, kma_sample_dropped);
+    int taken = cross(rate);
+    printf("rate %ld, set while another thread runs: %d samples taken of its %ld bytes\n", rate, taken,
+           (long) CROSS_STEPS * 64);
+    if (!taken) {
+        failed = 1;
+    }
+    return failed;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ns per step of a run through kma_malloc/kma_free sampling every rate
+// bytes, or with direct, through the backend's hooks past them
+double churn(long rate, int direct) {
+    int i;
+
+    kma_sample(rate);
+    double start = now();
+    for (i = 0; i < STEPS; i++) {
+        int slot = slots[i];
+        if (ptrs[slot]) {
+            if (direct) {
+                kma_current->free(ptrs[slot], live[slot]);
+            } else {
+                kma_free(ptrs[slot], live[slot]);
+            }
+        }
+        live[slot] = sizes[i];
+        ptrs[slot] = direct ? kma_current->malloc(sizes[i]) : kma_malloc(sizes[i]);
+        if (!ptrs[slot]) {
+            error("malloc failed", kma_current->name);
+        }
+    }
+    double ns = (now() - start) * 1e9 / STEPS;
+    for (i = 0; i < LIVE; i++) {
+        if (ptrs[i]) {
+            kma_free(ptrs[i], live[i]);
+            ptrs[i] = NULL;
+        }
+    }
+    if (kma_current->flush) {
+        kma_current->flush();
+    }
+    kma_sample(0);
+    return ns;
+}
+
+double best(double sofar, double ns) {
+    return sofar < 0 || ns < sofar ? ns : sofar;
+}
+
+// samples taken in a thread that allocated before the rate was set
+int cross(long rate) {
+    pthread_t thread;
+    int taken = kma_sample_taken;
+
+    pthread_barrier_init(&barrier, NULL, 2);
+    pthread_create(&thread, NULL, worker, NULL);
+    pthread_barrier_wait(&barrier);
+    kma_sample(rate);
+    pthread_barrier_wait(&barrier);
+    pthread_join(thread, NULL);
+    kma_sample(0);
+    pthread_barrier_destroy(&barrier);
+    return kma_sample_taken - taken;
+}
+
+void *worker(void *arg) {
+    int i;
+
+    kma_free(kma_malloc(64), 64);
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < CROSS_STEPS; i++) {
+        kma_free(kma_malloc(64), 64);
+    }
+    return NULL;
+}
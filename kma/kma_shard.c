@@ -0,0 +1,414 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Kernel memory allocator with free lists sharded per page
+ *             and per thread (in the style of mimalloc)
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_SHARD_IMPL__
+
+/************System include***********************************************/
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_shard.h"
+#include "kma_sizeclass.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#define MAXHEAPS 64
+
+/*
+ * Each thread owns a heap, and each page belongs to one heap and serves
+ * one size class. A page keeps three free lists:
+ *   free        - the owner allocates from it, no atomics
+ *   local_free  - the owner frees into it, no atomics
+ *   thread_free - other threads push onto it with a CAS
+ * When free runs dry the owner folds the other two back into it. Only
+ * the owner changes used, so an empty page is noticed without atomics.
+ *
+ * Pages with no free block leave the heap's queue and are marked full.
+ * A thread that frees into a full page also pushes the page once onto
+ * the owner's delayed list, so the owner finds it again without
+ * scanning its full pages. A remote free counts itself in pending
+ * until it is done with the page, which is not given back meanwhile.
+ *
+ * A thread that exits collects its heap and gives up the slot, but the
+ * heap keeps its pages: blocks still in use there are freed remotely
+ * as before, and the next thread to take the slot owns them, with the
+ * delayed list, from then on. So MAXHEAPS bounds the threads alive at
+ * once, not those of the process's lifetime.
+ */
+typedef struct page_t {
+    void *free;
+    void *local_free;
+    void *thread_free;
+    kma_size_t used;
+    kma_size_t full;
+    kma_size_t delayed;
+    kma_size_t pending;
+    kma_size_t idx;
+    kma_size_t block_size;
+    struct heap_t *heap;
+    kma_page_t *page;
+    struct page_t *prev;
+    struct page_t *next;
+    struct page_t *delayed_next;
+} page_t;
+
+typedef struct heap_t {
+    page_t *pages[KMA_SC_NCLASSES];
+    page_t *delayed;
+    kma_size_t in_use;
+} heap_t;
+
+static page_t page_stat[MAXPAGES];
+static heap_t heap_stat[MAXHEAPS];
+static __thread heap_t *my_heap = NULL;
+static pthread_once_t heap_once = PTHREAD_ONCE_INIT;
+static pthread_key_t heap_key;
+
+static void heap_release(void *);
+
+static void heap_init() {
+    pthread_key_create(&heap_key, heap_release);
+}
+
+
+// the first free slot, taken with a CAS, as threads come and go
+static heap_t *heap_get() {
+    if (!my_heap) {
+        int i;
+        pthread_once(&heap_once, heap_init);
+        for (i = 0; i < MAXHEAPS; i++) {
+            kma_size_t unused = 0;
+            if (__atomic_compare_exchange_n(&heap_stat[i].in_use, &unused, 1, FALSE,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        if (i == MAXHEAPS) {
+            error("too many threads for KMA_SHARD", "");
+        }
+        my_heap = heap_stat + i;
+        pthread_setspecific(heap_key, my_heap);
+    }
+    return my_heap;
+}
+
+
+static void queue_push(heap_t *heap, page_t *pg) {
+    pg->prev = NULL;
+    pg->next = heap->pages[pg->idx];
+    if (pg->next) {
+        pg->next->prev = pg;
+    }
+    heap->pages[pg->idx] = pg;
+}
+
+
+static void queue_unlink(heap_t *heap, page_t *pg) {
+    if (pg->prev) {
+        pg->prev->next = pg->next;
+    } else {
+        heap->pages[pg->idx] = pg->next;
+    }
+    if (pg->next) {
+        pg->next->prev = pg->prev;
+    }
+}
+
+
+// NULL when the pool is full, which the shim falls back from
+static page_t *page_new(heap_t *heap, kma_size_t idx) {
+    pthread_mutex_lock(&kma_page_lock);
+    kma_page_t *page = get_pages(1);
+    pthread_mutex_unlock(&kma_page_lock);
+    if (!page) {
+        return NULL;
+    }
+    page_t *pg = page_stat + page_index(page->ptr);
+    pg->page = page;
+    pg->heap = heap;
+    pg->idx = idx;
+    pg->block_size = kma_sc_size[idx];
+    pg->used = 0;
+    pg->free = NULL;
+    pg->local_free = NULL;
+    pg->thread_free = NULL;
+    pg->full = 0;
+    pg->delayed = 0;
+    return pg;
+}
+
+
+static void page_release(page_t *pg) {
+    pthread_mutex_lock(&kma_page_lock);
+    free_page(pg->page);
+    pthread_mutex_unlock(&kma_page_lock);
+}
+
+
+// owner only: nothing on the page is in use or on its way back
+static bool page_idle(page_t *pg) {
+    return !pg->used && !__atomic_load_n(&pg->delayed, __ATOMIC_SEQ_CST)
+           && !__atomic_load_n(&pg->pending, __ATOMIC_SEQ_CST);
+}
+
+
+static void page_carve(page_t *pg) {
+    kma_size_t bufsize = pg->block_size;
+    void *ptr;
+    for (ptr = pg->page->ptr; ptr + 2 * bufsize <= pg->page->ptr + pg->page->size; ptr += bufsize) {
+        *((kma_link_t *)ptr) = kma_link(ptr + bufsize);
+    }
+    *((kma_link_t *)ptr) = kma_link(NULL);
+    pg->free = pg->page->ptr;
+}
+
+
+// owner only: fold local and remote frees back into free
+static void page_collect(page_t *pg) {
+    if (!pg->free) {
+        pg->free = pg->local_free;
+        pg->local_free = NULL;
+    }
+    void *block = __atomic_exchange_n(&pg->thread_free, NULL, __ATOMIC_ACQUIRE);
+    while (block) {
+        void *next = kma_ptr(*((kma_link_t *)block));
+        *((kma_link_t *)block) = kma_link(pg->free);
+        pg->free = block;
+        pg->used--;
+        block = next;
+    }
+}
+
+
+/*
+ * Take the page off the queue. A remote free that raced with us either
+ * left its block where the re-check sees it, or saw full set and queued
+ * the page on our delayed list.
+ */
+static kma_size_t page_mark_full(heap_t *heap, page_t *pg) {
+    queue_unlink(heap, pg);
+    __atomic_store_n(&pg->full, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pg->thread_free, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&pg->full, 0, __ATOMIC_RELAXED);
+        queue_push(heap, pg);
+        page_collect(pg);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+static void heap_delayed(heap_t *heap) {
+    page_t *pg = __atomic_exchange_n(&heap->delayed, NULL, __ATOMIC_ACQUIRE);
+    while (pg) {
+        page_t *next = pg->delayed_next;
+        __atomic_store_n(&pg->delayed, 0, __ATOMIC_SEQ_CST);
+        if (pg->heap == heap && pg->full) {
+            page_collect(pg);
+            if (pg->free) {
+                __atomic_store_n(&pg->full, 0, __ATOMIC_RELAXED);
+                queue_push(heap, pg);
+            }
+        }
+        pg = next;
+    }
+}
+
+
+static void *malloc_generic(heap_t *heap, kma_size_t idx) {
+    heap_delayed(heap);
+    page_t *pg = heap->pages[idx];
+    while (pg) {
+        page_t *next = pg->next;
+        page_collect(pg);
+        if (pg->free || !page_mark_full(heap, pg)) {
+            if (pg != heap->pages[idx]) {
+                queue_unlink(heap, pg);
+                queue_push(heap, pg);
+            }
+            break;
+        }
+        pg = next;
+    }
+    if (!pg) {
+        if (!(pg = page_new(heap, idx))) {
+            return NULL;
+        }
+        page_carve(pg);
+        queue_push(heap, pg);
+    }
+    void *space = pg->free;
+    pg->free = kma_ptr(*((kma_link_t *)space));
+    pg->used++;
+    return space;
+}
+
+
+static void heap_collect(heap_t *heap) {
+    heap_delayed(heap);
+    kma_size_t idx;
+    for (idx = 0; idx < KMA_SC_NCLASSES; idx++) {
+        page_t *pg = heap->pages[idx];
+        while (pg) {
+            page_t *next = pg->next;
+            page_collect(pg);
+            if (page_idle(pg)) {
+                queue_unlink(heap, pg);
+                page_release(pg);
+            }
+            pg = next;
+        }
+    }
+}
+
+
+// the caller's heap, and those that threads left behind, each claimed
+// while it is collected
+void kma_shard_collect() {
+    int i;
+
+    heap_collect(heap_get());
+    for (i = 0; i < MAXHEAPS; i++) {
+        kma_size_t unused = 0;
+        if (__atomic_compare_exchange_n(&heap_stat[i].in_use, &unused, 1, FALSE,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            heap_collect(heap_stat + i);
+            __atomic_store_n(&heap_stat[i].in_use, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+
+// at thread exit: the pages stay with the heap for the next owner
+static void heap_release(void *arg) {
+    heap_t *heap = arg;
+    heap_collect(heap);
+    my_heap = NULL;
+    __atomic_store_n(&heap->in_use, 0, __ATOMIC_RELEASE);
+}
+
+
+static void *shard_malloc(kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    heap_t *heap = heap_get();
+    kma_size_t idx = kma_sc_index(size);
+    if (kma_sc_size[idx] > PAGESIZE / 2) {
+        page_t *pg = page_new(heap, idx);
+        if (!pg) {
+            return NULL;
+        }
+        pg->used = 1;
+        return pg->page->ptr;
+    }
+    page_t *pg = heap->pages[idx];
+    if (pg && pg->free) {
+        void *space = pg->free;
+        pg->free = kma_ptr(*((kma_link_t *)space));
+        pg->used++;
+        return space;
+    }
+    return malloc_generic(heap, idx);
+}
+
+static void shard_free(void *ptr, kma_size_t size) {
+    page_t *pg = page_stat + page_index(ptr);
+    if (pg->block_size > PAGESIZE / 2) {
+        page_release(pg);
+        return;
+    }
+    heap_t *heap = heap_get();
+    if (pg->heap == heap) {
+        *((kma_link_t *)ptr) = kma_link(pg->local_free);
+        pg->local_free = ptr;
+        pg->used--;
+        if (page_idle(pg)) {
+            if (!pg->full) {
+                queue_unlink(heap, pg);
+            }
+            page_release(pg);
+        } else if (pg->full) {
+            __atomic_store_n(&pg->full, 0, __ATOMIC_RELAXED);
+            queue_push(heap, pg);
+        }
+        return;
+    }
+    __atomic_add_fetch(&pg->pending, 1, __ATOMIC_SEQ_CST);
+    void *head = __atomic_load_n(&pg->thread_free, __ATOMIC_RELAXED);
+    do {
+        *((kma_link_t *)ptr) = kma_link(head);
+    } while (!__atomic_compare_exchange_n(&pg->thread_free, &head, ptr, TRUE,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    if (__atomic_load_n(&pg->full, __ATOMIC_SEQ_CST)
+        && !__atomic_exchange_n(&pg->delayed, 1, __ATOMIC_SEQ_CST)) {
+        heap_t *owner = pg->heap;
+        page_t *d = __atomic_load_n(&owner->delayed, __ATOMIC_RELAXED);
+        do {
+            pg->delayed_next = d;
+        } while (!__atomic_compare_exchange_n(&owner->delayed, &d, pg, TRUE,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    __atomic_sub_fetch(&pg->pending, 1, __ATOMIC_SEQ_CST);
+}
+
+static kma_size_t shard_size(void *ptr) {
+    return page_stat[page_index(ptr)].block_size;
+}
+
+// in place while the new size maps to the block's own class
+static bool shard_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (new_size <= 0 || new_size > PAGESIZE) {
+        return FALSE;
+    }
+    return kma_sc_size[kma_sc_index(new_size)] == page_stat[page_index(ptr)].block_size;
+}
+
+// blocks lie back to back from the page start, so a class whose size
+// is a multiple of align aligns every block
+static void *shard_memalign(kma_size_t align, kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE) {
+        return NULL;
+    }
+    return shard_malloc(kma_sc_size[kma_sc_index_aligned(size, align)]);
+}
+
+kma_backend_t kma_shard_backend = {
+    .name = "shard",
+    .malloc = shard_malloc,
+    .free = shard_free,
+    .flush = kma_shard_collect,
+    .size = shard_size,
+    .resize = shard_resize,
+    .memalign = shard_memalign
+};
@@ -0,0 +1,57 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Thread interface of the sharded free list allocator
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_SHARD_H__
+#define __KMA_SHARD_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_SHARD_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Collects the calling thread's heap
+ * ---------------------------------------------------------------------
+ *    Purpose: Takes back the blocks other threads freed into the
+ *             calling thread's pages, and into those of the heaps
+ *             threads left when they exited, and releases the pages
+ *             that are empty. A thread's heap is also collected when
+ *             it exits
+ *    Input: none
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_shard_collect();
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_SHARD_H__ */
@@ -0,0 +1,379 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: malloc/free/calloc/realloc on top of a KMA backend, to be
+ *             loaded into unmodified programs with LD_PRELOAD
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// the library is built with -fvisibility=hidden; only these leave it
+#define KMA_EXPORT __attribute__((visibility("default")))
+
+// bytes in front of a block that carry its size; keeps 16-byte alignment
+#define HEADER 16
+
+// the largest request every backend must serve
+#define SMALL_MAX (PAGESIZE - sizeof(void *))
+
+#define MMAP_PAGE 4096
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * Blocks come from one of three places:
+ *   - the backend, which can tell a block's size from its page
+ *     metadata (backend->size); the pointer is returned as is, asked
+ *     for with backend->memalign, as malloc must align blocks for any
+ *     type and some backends only align to 8 bytes
+ *   - the backend, which cannot; the size goes into a HEADER in front
+ *   - a private mmap for requests the backend does not serve; a HEADER
+ *     in front holds the mapping length and the offset of the block
+ * free() tells the first two from the last with page_contains(). The
+ * backends are not thread safe, so one lock covers every call into
+ * them and the page layer; the mmap path needs none.
+ */
+typedef struct header_t {
+    size_t size;   // requested size, or the mapping length for mmap
+    size_t offset; // distance from the mapping start, for mmap only
+} header_t;
+
+/************Global Variables*********************************************/
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static kma_backend_t *backend = NULL;
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+static void prepare_fork() {
+    pthread_mutex_lock(&lock);
+}
+
+static void after_fork() {
+    pthread_mutex_unlock(&lock);
+}
+
+static void __attribute__((constructor)) shim_init() {
+    pthread_atfork(prepare_fork, after_fork, after_fork);
+}
+
+// with lock held: KMA_BACKEND=<name> picks the backend, once
+static kma_backend_t *backend_get() {
+    if (!backend) {
+        char *name = getenv("KMA_BACKEND");
+        backend = kma_current;
+        if (name && kma_backend_find(name)) {
+            backend = kma_backend_find(name);
+        }
+    }
+    return backend;
+}
+
+void error(char *message, char *arg) {
+    static const char prefix[] = "libkma: ";
+    write(2, prefix, sizeof(prefix) - 1);
+    write(2, message, strlen(message));
+    write(2, " ", 1);
+    write(2, arg, strlen(arg));
+    write(2, "\n", 1);
+    abort();
+}
+
+
+static void *large_alloc(size_t size, size_t align) {
+    if (align < HEADER) {
+        align = HEADER;
+    }
+    if (size > SIZE_MAX - align - HEADER - MMAP_PAGE) {
+        return NULL;
+    }
+    size_t length = ROUNDUP(size + align + HEADER, MMAP_PAGE);
+    void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    void *ptr = (void *)ROUNDUP((uintptr_t)map + HEADER, align);
+    header_t *hdr = ptr - HEADER;
+    hdr->size = length;
+    hdr->offset = ptr - map;
+    return ptr;
+}
+
+static void large_free(void *ptr) {
+    header_t *hdr = ptr - HEADER;
+    munmap(ptr - hdr->offset, hdr->size);
+}
+
+static size_t large_size(void *ptr) {
+    header_t *hdr = ptr - HEADER;
+    return hdr->size - hdr->offset;
+}
+
+
+// with lock held
+static void *small_alloc(size_t size) {
+    kma_backend_t *b = backend_get();
+    if (b->size) {
+        return size <= SMALL_MAX ? b->memalign(HEADER, size) : NULL;
+    }
+    if (size > SMALL_MAX - HEADER) {
+        return NULL;
+    }
+    header_t *hdr = b->malloc(size + HEADER);
+    if (!hdr) {
+        return NULL;
+    }
+    hdr->size = size;
+    return (void *)hdr + HEADER;
+}
+
+// with lock held: small_alloc, zero filled; what the backend knows to be
+// zero already is not cleared again
+static void *small_calloc(size_t size) {
+    kma_backend_t *b = backend_get();
+    kma_size_t dirty;
+    if (!b->calloc) {
+        void *ptr = small_alloc(size);
+        if (ptr) {
+            memset(ptr, 0, size);
+        }
+        return ptr;
+    }
+    if (b->size) {
+        void *ptr = size <= SMALL_MAX ? b->calloc(size, &dirty) : NULL;
+        if (ptr && ((uintptr_t)ptr & (HEADER - 1))) {
+            // not aligned for every type: take an aligned block instead
+            b->free(ptr, b->size(ptr));
+            ptr = small_alloc(size);
+            dirty = size;
+        }
+        if (ptr) {
+            memset(ptr, 0, dirty);
+        }
+        return ptr;
+    }
+    if (size > SMALL_MAX - HEADER) {
+        return NULL;
+    }
+    header_t *hdr = b->calloc(size + HEADER, &dirty);
+    if (!hdr) {
+        return NULL;
+    }
+    hdr->size = size;
+    if (dirty > HEADER) {
+        memset((void *)hdr + HEADER, 0, dirty - HEADER);
+    }
+    return (void *)hdr + HEADER;
+}
+
+// with lock held: only a backend that can tell the size of an aligned
+// block from its pointer can serve one; the others leave it to malloc
+static void *small_memalign(size_t align, size_t size) {
+    kma_backend_t *b = backend_get();
+    if (!b->size || !b->memalign || align > PAGESIZE || size > SMALL_MAX) {
+        return NULL;
+    }
+    return b->memalign(align, size);
+}
+
+// with lock held
+static void small_free(void *ptr) {
+    if (backend->size) {
+        backend->free(ptr, backend->size(ptr));
+    } else {
+        header_t *hdr = ptr - HEADER;
+        backend->free(hdr, hdr->size + HEADER);
+    }
+}
+
+// with lock held
+static size_t small_size(void *ptr) {
+    if (backend->size) {
+        return backend->size(ptr);
+    }
+    return ((header_t *)(ptr - HEADER))->size;
+}
+
+// with lock held: grow or shrink the block where it is, if the backend can
+static bool small_resize(void *ptr, size_t size) {
+    if (!backend->resize || size > SMALL_MAX - HEADER) {
+        return FALSE;
+    }
+    if (backend->size) {
+        return backend->resize(ptr, backend->size(ptr), size);
+    }
+    header_t *hdr = ptr - HEADER;
+    if (!backend->resize(hdr, hdr->size + HEADER, size + HEADER)) {
+        return FALSE;
+    }
+    hdr->size = size;
+    return TRUE;
+}
+
+
+KMA_EXPORT void *malloc(size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    pthread_mutex_lock(&lock);
+    void *ptr = small_alloc(size);
+    pthread_mutex_unlock(&lock);
+    if (!ptr) {
+        ptr = large_alloc(size, HEADER);
+    }
+    if (!ptr) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+KMA_EXPORT void free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    if (page_contains(ptr)) {
+        small_free(ptr);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    pthread_mutex_unlock(&lock);
+    large_free(ptr);
+}
+
+KMA_EXPORT size_t malloc_usable_size(void *ptr) {
+    size_t size;
+
+    if (!ptr) {
+        return 0;
+    }
+    pthread_mutex_lock(&lock);
+    if (page_contains(ptr)) {
+        size = small_size(ptr);
+    } else {
+        size = large_size(ptr);
+    }
+    pthread_mutex_unlock(&lock);
+    return size;
+}
+
+KMA_EXPORT void *calloc(size_t nmemb, size_t size) {
+    if (size && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size *= nmemb;
+    if (size == 0) {
+        size = 1;
+    }
+    pthread_mutex_lock(&lock);
+    void *ptr = small_calloc(size);
+    pthread_mutex_unlock(&lock);
+    // fresh mappings are zero already
+    if (!ptr) {
+        ptr = large_alloc(size, HEADER);
+    }
+    if (!ptr) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+KMA_EXPORT void *realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    pthread_mutex_lock(&lock);
+    if (page_contains(ptr) && small_resize(ptr, size)) {
+        pthread_mutex_unlock(&lock);
+        return ptr;
+    }
+    pthread_mutex_unlock(&lock);
+    size_t old = malloc_usable_size(ptr);
+    if (size <= old) {
+        return ptr;
+    }
+    void *res = malloc(size);
+    if (res) {
+        memcpy(res, ptr, old);
+        free(ptr);
+    }
+    return res;
+}
+
+KMA_EXPORT int posix_memalign(void **memptr, size_t align, size_t size) {
+    if (align < sizeof(void *) || (align & (align - 1))) {
+        return EINVAL;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+    pthread_mutex_lock(&lock);
+    void *ptr = small_memalign(align, size);
+    pthread_mutex_unlock(&lock);
+    // most blocks are aligned well enough already
+    if (!ptr) {
+        ptr = malloc(size);
+    }
+    if (ptr && ((uintptr_t)ptr & (align - 1))) {
+        free(ptr);
+        ptr = large_alloc(size, align);
+    }
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+KMA_EXPORT void *aligned_alloc(size_t align, size_t size) {
+    void *ptr;
+    int err = posix_memalign(&ptr, align < sizeof(void *) ? sizeof(void *) : align, size);
+    if (err) {
+        errno = err;
+        return NULL;
+    }
+    return ptr;
+}
+
+KMA_EXPORT void *memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+KMA_EXPORT void *valloc(size_t size) {
+    return aligned_alloc(MMAP_PAGE, size);
+}
@@ -0,0 +1,149 @@
+/***************************************************************************
+ *  Title: Size Classes
+ * -------------------------------------------------------------------------
+ *    Purpose: Compile-time size class tables shared by the allocators
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_SIZECLASS_H__
+#define __KMA_SIZECLASS_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/*
+ * A trace-tuned class set can be swapped in at build time with
+ * -DKMA_SC_TABLE='"header"', where the header is written by
+ * testsuite/optimize_classes. Otherwise classes are spaced like jemalloc:
+ * the first KMA_SC_NDIV classes are multiples of the quantum, after that
+ * every doubling of the size is cut into KMA_SC_NDIV equal steps.
+ * KMA_SC_LG_NDIV = 0 gives the plain power-of-two ladder 16, 32, ...,
+ * PAGESIZE; 2 gives 16, 32, 48, 64, 80, 96, 112, 128, 160, ...
+ */
+
+// the smallest block and the alignment of all of them, for either class
+// set; a table's index is in steps of it
+#define KMA_SC_LG_QUANTUM 4
+
+#ifdef KMA_SC_TABLE
+#include KMA_SC_TABLE
+#else
+
+#ifndef KMA_SC_LG_NDIV
+#define KMA_SC_LG_NDIV 0
+#endif
+
+#define KMA_SC_LG_MAX 13
+#define KMA_SC_NDIV (1 << KMA_SC_LG_NDIV)
+
+#if KMA_SC_LG_NDIV < 0 || KMA_SC_LG_NDIV > 3
+#error "KMA_SC_LG_NDIV must be between 0 and 3"
+#endif
+
+#if (1 << KMA_SC_LG_MAX) != PAGESIZE
+#error "KMA_SC_LG_MAX must match PAGESIZE"
+#endif
+
+// the largest class is PAGESIZE
+#define KMA_SC_NCLASSES \
+    (KMA_SC_NDIV * (KMA_SC_LG_MAX - KMA_SC_LG_QUANTUM - KMA_SC_LG_NDIV + 1))
+
+#define KMA_SC_GRP(i) ((i) >> KMA_SC_LG_NDIV)
+#define KMA_SC_SHIFT(i) (KMA_SC_GRP(i) ? KMA_SC_GRP(i) - 1 : 0)
+#define KMA_SC_SIZE(i)                                                      \
+    ((KMA_SC_GRP(i) ? KMA_SC_NDIV << (KMA_SC_LG_QUANTUM + KMA_SC_SHIFT(i)) : 0) \
+     + ((((i) & (KMA_SC_NDIV - 1)) + 1) << (KMA_SC_LG_QUANTUM + KMA_SC_SHIFT(i))))
+
+#define KMA_SC_E1(i) ((i) < KMA_SC_NCLASSES ? KMA_SC_SIZE(i) : 0)
+#define KMA_SC_E4(i) KMA_SC_E1(i), KMA_SC_E1(i + 1), KMA_SC_E1(i + 2), KMA_SC_E1(i + 3)
+#define KMA_SC_E16(i) KMA_SC_E4(i), KMA_SC_E4(i + 4), KMA_SC_E4(i + 8), KMA_SC_E4(i + 12)
+
+/************Global Variables*********************************************/
+
+// class index -> block size, folded by the compiler
+static const kma_size_t kma_sc_size[64] = {
+    KMA_SC_E16(0), KMA_SC_E16(16), KMA_SC_E16(32), KMA_SC_E16(48)
+};
+
+#endif // KMA_SC_TABLE
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Size class index
+ * ---------------------------------------------------------------------
+ *    Purpose: Map a request size to the smallest class that holds it,
+ *             without branches (the conditionals compile to cmov)
+ *    Input: the size, 1 <= size <= PAGESIZE
+ *    Output: the class index, kma_sc_size[index] >= size
+ ***********************************************************************/
+static inline kma_size_t kma_sc_index(kma_size_t size) {
+#ifdef KMA_SC_TABLE
+    return kma_sc_index_table[(size + (1 << KMA_SC_LG_QUANTUM) - 1) >> KMA_SC_LG_QUANTUM];
+#else
+    unsigned int s = size < (1 << KMA_SC_LG_QUANTUM) ? (1 << KMA_SC_LG_QUANTUM) : size;
+    unsigned int lg = 31 - __builtin_clz((s << 1) - 1);
+    unsigned int grp = lg < KMA_SC_LG_NDIV + KMA_SC_LG_QUANTUM
+        ? 0 : lg - (KMA_SC_LG_NDIV + KMA_SC_LG_QUANTUM);
+    unsigned int lg_delta = lg < KMA_SC_LG_NDIV + KMA_SC_LG_QUANTUM + 1
+        ? KMA_SC_LG_QUANTUM : lg - KMA_SC_LG_NDIV - 1;
+
+    return (grp << KMA_SC_LG_NDIV) + (((s - 1) >> lg_delta) & (KMA_SC_NDIV - 1));
+#endif
+}
+
+/***********************************************************************
+ *  Title: Aligned size class index
+ * ---------------------------------------------------------------------
+ *    Purpose: Map a request size to the smallest class that holds it
+ *             and whose blocks, laid out back to back from the start
+ *             of a page, all begin on an align boundary
+ *    Input: the size, 1 <= size <= PAGESIZE, and a power-of-two
+ *           alignment <= PAGESIZE
+ *    Output: the class index; the PAGESIZE class always qualifies
+ ***********************************************************************/
+static inline kma_size_t kma_sc_index_aligned(kma_size_t size, kma_size_t align) {
+    kma_size_t idx = kma_sc_index(size);
+
+    while (kma_sc_size[idx] & (align - 1)) {
+        idx++;
+    }
+    return idx;
+}
+
+/***********************************************************************
+ *  Title: Power-of-two class index
+ * ---------------------------------------------------------------------
+ *    Purpose: Map a request size to a power-of-two class for allocators
+ *             that need power-of-two blocks (e.g. buddy)
+ *    Input: the size and the log2 of the smallest block
+ *    Output: the index i of the smallest block 1 << (minpower + i)
+ *            that holds size
+ ***********************************************************************/
+static inline kma_size_t kma_sc_pow2_index(kma_size_t size, kma_size_t minpower) {
+    unsigned int s = size < (1 << minpower) ? (1 << minpower) : size;
+
+    return 31 - __builtin_clz((s << 1) - 1) - minpower;
+}
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_SIZECLASS_H__ */
@@ -0,0 +1,407 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Kernel memory allocator based on Bonwick's slab allocator
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+#define __KMA_SLAB_IMPL__
+
+/************System include***********************************************/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+#include "kma_slab.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+#define PTRSIZE sizeof(void *)
+#define COLOUR 64
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/*
+ * A slab is one page. Its descriptor lives off the page in slab_stat,
+ * found through page_index(), so the whole page holds buffers. Free
+ * buffers are threaded through a kma_link_t (the bufctl) at offset link
+ * of each buffer. Caches without a constructor overlay the link on the
+ * object; caches with one append it, so a freed object keeps its
+ * constructed state.
+ */
+typedef struct slab_t {
+    kma_page_t *page;
+    kma_cache_t *cache;
+    void *free;
+    kma_size_t in_use;
+    struct slab_t *prev;
+    struct slab_t *next;
+} slab_t;
+
+struct kma_cache_t {
+    char name[32];
+    kma_size_t size;
+    kma_size_t stride;
+    kma_size_t link;
+    kma_size_t per_slab;
+    kma_size_t colour;
+    kma_size_t colour_step;
+    kma_size_t colour_max;
+    kma_size_t keep_empty;
+    kma_size_t num_empty;
+    kma_size_t num_slabs;
+    kma_cache_fn_t ctor;
+    kma_cache_fn_t dtor;
+    slab_t *full;
+    slab_t *partial;
+    slab_t *empty;
+    struct kma_cache_t *next;
+};
+
+static slab_t slab_stat[MAXPAGES];
+
+// caches are objects too; this one is never destroyed
+static kma_cache_t cache_cache;
+
+// every cache created, for the flush to reap
+static kma_cache_t *caches = NULL;
+
+// auto-created caches behind kma_malloc, one per 8-byte-rounded size;
+// each lives until a flush finds it without slabs
+static kma_cache_t *size_cache[PAGESIZE / PTRSIZE + 1] = {0};
+
+// and behind kma_memalign, one per size rounded to the alignment; each is
+// aligned to the lowest set bit of its size, which covers every request
+// that rounds to it
+static kma_cache_t *aligned_cache[PAGESIZE / PTRSIZE + 1] = {0};
+
+
+static void cache_init(kma_cache_t *cp, char *name, kma_size_t size, kma_size_t align,
+                kma_cache_fn_t ctor, kma_cache_fn_t dtor) {
+    snprintf(cp->name, sizeof(cp->name), "%s", name);
+    cp->size = size;
+    cp->link = ctor ? ROUNDUP(size, PTRSIZE) : 0;
+    cp->stride = ROUNDUP(cp->link + sizeof(kma_link_t) > size ? cp->link + sizeof(kma_link_t) : size, align);
+    cp->per_slab = PAGESIZE / cp->stride;
+    cp->colour = 0;
+    cp->colour_step = align > COLOUR ? align : COLOUR;
+    cp->colour_max = PAGESIZE - cp->per_slab * cp->stride;
+    cp->keep_empty = 0;
+    cp->num_empty = 0;
+    cp->num_slabs = 0;
+    cp->ctor = ctor;
+    cp->dtor = dtor;
+    cp->full = NULL;
+    cp->partial = NULL;
+    cp->empty = NULL;
+}
+
+
+static slab_t **slab_list(kma_cache_t *cp, slab_t *sp) {
+    if (sp->in_use == cp->per_slab) {
+        return &cp->full;
+    }
+    return sp->in_use ? &cp->partial : &cp->empty;
+}
+
+
+static void slab_push(slab_t **head, slab_t *sp) {
+    sp->prev = NULL;
+    sp->next = *head;
+    if (sp->next) {
+        sp->next->prev = sp;
+    }
+    *head = sp;
+}
+
+
+static void slab_unlink(slab_t **head, slab_t *sp) {
+    if (sp->prev) {
+        sp->prev->next = sp->next;
+    } else {
+        *head = sp->next;
+    }
+    if (sp->next) {
+        sp->next->prev = sp->prev;
+    }
+}
+
+
+// NULL when the pool is full, which the shim falls back from
+static slab_t *slab_create(kma_cache_t *cp) {
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    slab_t *sp = slab_stat + page_index(page->ptr);
+    sp->page = page;
+    sp->cache = cp;
+    sp->in_use = 0;
+    sp->free = NULL;
+
+    // colour shifts the first buffer so equal objects of different
+    // slabs do not all compete for the same cache lines
+    void *base = page->ptr + cp->colour;
+    cp->colour += cp->colour_step;
+    if (cp->colour > cp->colour_max) {
+        cp->colour = 0;
+    }
+
+    kma_size_t i = cp->per_slab;
+    while (i-- > 0) {
+        void *buf = base + i * cp->stride;
+        if (cp->ctor) {
+            cp->ctor(buf, cp->size);
+        }
+        *((kma_link_t *)(buf + cp->link)) = kma_link(sp->free);
+        sp->free = buf;
+    }
+    cp->num_slabs++;
+    cp->num_empty++;
+    slab_push(&cp->empty, sp);
+    return sp;
+}
+
+
+static void slab_destroy(kma_cache_t *cp, slab_t *sp) {
+    assert(sp->in_use == 0);
+    slab_unlink(&cp->empty, sp);
+    cp->num_empty--;
+    cp->num_slabs--;
+    if (cp->dtor) {
+        void *buf;
+        for (buf = sp->free; buf; buf = kma_ptr(*((kma_link_t *)(buf + cp->link)))) {
+            cp->dtor(buf, cp->size);
+        }
+    }
+    free_page(sp->page);
+}
+
+
+kma_cache_t *kma_cache_create(char *name, kma_size_t size, kma_size_t align,
+                              kma_cache_fn_t ctor, kma_cache_fn_t dtor) {
+    if (size <= 0 || size > PAGESIZE - PTRSIZE || (align & (align - 1))) {
+        return NULL;
+    }
+    if (!cache_cache.size) {
+        cache_init(&cache_cache, "kma_cache", sizeof(kma_cache_t), PTRSIZE, NULL, NULL);
+    }
+    kma_cache_t *cp = kma_cache_alloc(&cache_cache);
+    if (!cp) {
+        return NULL;
+    }
+    cache_init(cp, name, size, align < PTRSIZE ? PTRSIZE : align, ctor, dtor);
+    if (!cp->per_slab) {
+        kma_cache_free(&cache_cache, cp);
+        return NULL;
+    }
+    // one empty slab stays cached, constructed, until the cache is reaped
+    cp->keep_empty = 1;
+    cp->next = caches;
+    caches = cp;
+    return cp;
+}
+
+
+int kma_cache_alloc_batch(kma_cache_t *cp, int n, void **objs) {
+    int got = 0;
+    while (got < n) {
+        slab_t *sp = cp->partial ? cp->partial : cp->empty ? cp->empty : slab_create(cp);
+        if (!sp) {
+            break;
+        }
+        slab_t **from = slab_list(cp, sp);
+        void *buf = sp->free;
+        kma_size_t taken = 0;
+        while (buf && got < n) {
+            objs[got++] = buf;
+            buf = kma_ptr(*((kma_link_t *)(buf + cp->link)));
+            taken++;
+        }
+        sp->free = buf;
+        sp->in_use += taken;
+        slab_t **to = slab_list(cp, sp);
+        if (from != to) {
+            slab_unlink(from, sp);
+            slab_push(to, sp);
+            if (from == &cp->empty) {
+                cp->num_empty--;
+            }
+        }
+    }
+    return got;
+}
+
+
+void *kma_cache_alloc(kma_cache_t *cp) {
+    void *buf;
+    return kma_cache_alloc_batch(cp, 1, &buf) ? buf : NULL;
+}
+
+
+void kma_cache_free_batch(kma_cache_t *cp, void **objs, int n) {
+    int i = 0;
+    while (i < n) {
+        slab_t *sp = slab_stat + page_index(objs[i]);
+        assert(sp->cache == cp);
+        slab_t **from = slab_list(cp, sp);
+        kma_size_t count = 0;
+        for (; i < n && slab_stat + page_index(objs[i]) == sp; i++, count++) {
+            *((kma_link_t *)(objs[i] + cp->link)) = kma_link(sp->free);
+            sp->free = objs[i];
+        }
+        sp->in_use -= count;
+        slab_t **to = slab_list(cp, sp);
+        if (from != to) {
+            slab_unlink(from, sp);
+            slab_push(to, sp);
+            if (to == &cp->empty && ++cp->num_empty > cp->keep_empty) {
+                slab_destroy(cp, sp);
+            }
+        }
+    }
+}
+
+
+void kma_cache_free(kma_cache_t *cp, void *buf) {
+    kma_cache_free_batch(cp, &buf, 1);
+}
+
+
+void kma_cache_reap(kma_cache_t *cp) {
+    while (cp->empty) {
+        slab_destroy(cp, cp->empty);
+    }
+}
+
+
+void kma_cache_destroy(kma_cache_t *cp) {
+    assert(!cp->full && !cp->partial);
+    kma_cache_reap(cp);
+    kma_cache_t **cpp;
+    for (cpp = &caches; *cpp != cp; cpp = &(*cpp)->next) {
+    }
+    *cpp = cp->next;
+    kma_cache_free(&cache_cache, cp);
+}
+
+
+// the auto cache for size bytes aligned to align, created on first use
+static kma_cache_t *auto_cache(kma_cache_t **table, char *prefix, kma_size_t size, kma_size_t align) {
+    kma_size_t idx = size / PTRSIZE;
+    if (!table[idx]) {
+        char name[32];
+        snprintf(name, sizeof(name), "%s_%d", prefix, (int)size);
+        table[idx] = kma_cache_create(name, size, align, NULL, NULL);
+    }
+    return table[idx];
+}
+
+static void *slab_malloc(kma_size_t size) {
+    if (size <= 0 || size > PAGESIZE - PTRSIZE) {
+        return NULL;
+    }
+    kma_cache_t *cp = auto_cache(size_cache, "kma_size", ROUNDUP(size, PTRSIZE), 0);
+    return cp ? kma_cache_alloc(cp) : NULL;
+}
+
+static void *slab_memalign(kma_size_t align, kma_size_t size) {
+    if (align <= PTRSIZE) {
+        return slab_malloc(size);
+    }
+    if (size <= 0 || ROUNDUP(size, align) > PAGESIZE - PTRSIZE) {
+        return NULL;
+    }
+    size = ROUNDUP(size, align);
+    kma_cache_t *cp = auto_cache(aligned_cache, "kma_aligned", size, size & -size);
+    return cp ? kma_cache_alloc(cp) : NULL;
+}
+
+static int slab_malloc_batch(kma_size_t size, int n, void **out) {
+    if (size <= 0 || size > PAGESIZE - PTRSIZE) {
+        return 0;
+    }
+    kma_cache_t *cp = auto_cache(size_cache, "kma_size", ROUNDUP(size, PTRSIZE), 0);
+    return cp ? kma_cache_alloc_batch(cp, n, out) : 0;
+}
+
+// the cache comes from the slab, as aligned blocks are not in size_cache;
+// objects of one cache that follow each other are freed together
+static void slab_free_batch(void **ptrs, kma_size_t *sizes, int n) {
+    int i, j;
+    for (i = 0; i < n; i = j) {
+        kma_cache_t *cp = slab_stat[page_index(ptrs[i])].cache;
+        for (j = i + 1; j < n && slab_stat[page_index(ptrs[j])].cache == cp; j++) {
+        }
+        kma_cache_free_batch(cp, ptrs + i, j - i);
+    }
+}
+
+static void slab_free(void *ptr, kma_size_t size) {
+    slab_free_batch(&ptr, &size, 1);
+}
+
+static kma_size_t slab_size(void *ptr) {
+    return slab_stat[page_index(ptr)].cache->size;
+}
+
+// in place while the new size still rounds to the block's own cache
+static bool slab_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    kma_size_t size = slab_size(ptr);
+    return new_size > size - PTRSIZE && new_size <= size;
+}
+
+// the empty slab each cache keeps goes back, and with it every auto
+// cache left without slabs
+static void slab_flush() {
+    kma_cache_t *cp, *next;
+    for (cp = caches; cp; cp = next) {
+        next = cp->next;
+        kma_cache_reap(cp);
+        kma_size_t idx = cp->size / PTRSIZE;
+        if (cp->num_slabs || (size_cache[idx] != cp && aligned_cache[idx] != cp)) {
+            continue;
+        }
+        if (size_cache[idx] == cp) {
+            size_cache[idx] = NULL;
+        } else {
+            aligned_cache[idx] = NULL;
+        }
+        kma_cache_destroy(cp);
+    }
+}
+
+kma_backend_t kma_slab_backend = {
+    .name = "slab",
+    .malloc = slab_malloc,
+    .free = slab_free,
+    .flush = slab_flush,
+    .size = slab_size,
+    .resize = slab_resize,
+    .memalign = slab_memalign,
+    .malloc_batch = slab_malloc_batch,
+    .free_batch = slab_free_batch
+};
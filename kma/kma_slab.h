@@ -0,0 +1,121 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Object cache interface of the slab allocator
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#ifndef __KMA_SLAB_H__
+#define __KMA_SLAB_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#undef EXTERN
+#ifdef __KMA_SLAB_IMPL__
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+typedef struct kma_cache_t kma_cache_t;
+
+typedef void (*kma_cache_fn_t)(void *obj, kma_size_t size);
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Creates an object cache
+ * ---------------------------------------------------------------------
+ *    Purpose: Creates a cache of fixed-size objects. The constructor
+ *             runs once when a slab is created and the destructor
+ *             once when it is released, so a freed object keeps its
+ *             constructed state until it is handed out again
+ *    Input: a name, the object size (<= PAGESIZE - 8), the alignment
+ *           (0 for pointer alignment) and optional ctor/dtor hooks
+ *    Output: the cache or NULL on failure
+ ***********************************************************************/
+EXTERN kma_cache_t *kma_cache_create(char *name, kma_size_t size, kma_size_t align,
+                                     kma_cache_fn_t ctor, kma_cache_fn_t dtor);
+
+/***********************************************************************
+ *  Title: Allocates an object
+ * ---------------------------------------------------------------------
+ *    Purpose: Takes a constructed object from the cache
+ *    Input: the cache
+ *    Output: the object, or NULL if the pool is full
+ ***********************************************************************/
+EXTERN void *kma_cache_alloc(kma_cache_t *);
+
+/***********************************************************************
+ *  Title: Frees an object
+ * ---------------------------------------------------------------------
+ *    Purpose: Returns an object, which must be in its constructed
+ *             state, to its cache
+ *    Input: the cache, the object
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_cache_free(kma_cache_t *, void *);
+
+/***********************************************************************
+ *  Title: Allocates a batch of objects
+ * ---------------------------------------------------------------------
+ *    Purpose: Takes n constructed objects from the cache, a slab's
+ *             free chain at a time
+ *    Input: the cache, n, the array of n objects to fill
+ *    Output: the number of objects taken, n unless the pool is full
+ ***********************************************************************/
+EXTERN int kma_cache_alloc_batch(kma_cache_t *, int n, void **objs);
+
+/***********************************************************************
+ *  Title: Frees a batch of objects
+ * ---------------------------------------------------------------------
+ *    Purpose: Returns n objects, in their constructed state, to their
+ *             cache; objects of one slab that follow each other are
+ *             chained back onto it together
+ *    Input: the cache, the objects, n
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_cache_free_batch(kma_cache_t *, void **objs, int n);
+
+/***********************************************************************
+ *  Title: Reaps a cache
+ * ---------------------------------------------------------------------
+ *    Purpose: Releases all empty slabs of the cache to the page layer
+ *    Input: the cache
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_cache_reap(kma_cache_t *);
+
+/***********************************************************************
+ *  Title: Destroys a cache
+ * ---------------------------------------------------------------------
+ *    Purpose: Releases all slabs and the cache itself; every object
+ *             must have been freed
+ *    Input: the cache
+ *    Output: none
+ ***********************************************************************/
+EXTERN void kma_cache_destroy(kma_cache_t *);
+
+/************External Declaration*****************************************/
+
+/**************Definition***************************************************/
+
+#endif /* __KMA_SLAB_H__ */
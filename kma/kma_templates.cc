@@ -0,0 +1,42 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: The policy allocators of kma_policy.h as backends
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kma_policy.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+extern "C" {
+
+kma_backend_t kma_tmck2_backend = kma::policy::backend<kma::policy::tmck2>("tmck2");
+
+kma_backend_t kma_tp2fl_backend = kma::policy::backend<kma::policy::tp2fl>("tp2fl");
+
+kma_backend_t kma_tbud_backend = kma::policy::backend<kma::policy::tbud>("tbud");
+
+}
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
@@ -0,0 +1,411 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Kernel memory allocator based on the two-level segregated
+ *             fit (TLSF) algorithm
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+#define __KMA_IMPL__
+
+/************System include***********************************************/
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_backend.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+/************Global Variables*********************************************/
+
+/************Function Prototypes******************************************/
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+/*
+ * Free blocks are kept in FL_COUNT x SL_COUNT segregated lists: the first
+ * level splits sizes by power of two, the second level cuts each power
+ * of two into SL_COUNT ranges. A bit per list in sl_bitmap, and a bit per
+ * first level in fl_bitmap, make finding a big enough list two ffs.
+ *
+ * Every block starts with its size word; the low bits flag whether the
+ * block and its physical predecessor are free. A free block also stores
+ * its free list links in its payload and a pointer to itself in its last
+ * word (prev_phys of the next block), so both neighbours are reached in
+ * O(1) when it is coalesced. The free list links are kma_link_t, which
+ * with KMA_LINK32 shrinks the minimum block from 24 bytes to 16;
+ * prev_phys stays a pointer, as it sits in front of the size word and
+ * would otherwise leave that unaligned. Each page is an independent
+ * region: its first block begins at the page start and the last block
+ * ends at the page end. Every byte of a page from tlsf_clean on is
+ * zero: nothing has been handed out or written there since the page
+ * was mapped.
+ */
+
+#define ALIGN_LG 3
+#define SL_LG 4
+#define SL_COUNT (1 << SL_LG)
+#define FL_SHIFT (SL_LG + ALIGN_LG)
+#define FL_MAX 14
+#define FL_COUNT (FL_MAX - FL_SHIFT + 1)
+#define SMALL_BLOCK (1 << FL_SHIFT)
+
+#define BLOCK_FREE 0x1UL
+#define BLOCK_PREV_FREE 0x2UL
+#define BLOCK_FLAGS (BLOCK_FREE | BLOCK_PREV_FREE)
+
+typedef struct block_t {
+    struct block_t *prev_phys;
+    unsigned long size;
+    kma_link_t next_free;
+    kma_link_t prev_free;
+} block_t;
+
+#define OVERHEAD sizeof(unsigned long)
+#define PAYLOAD offsetof(block_t, next_free)
+// the free list links, and the pointer to itself in its last word
+#define MINBLOCK (sizeof(block_t) - PAYLOAD + sizeof(block_t *))
+#define PAGEBLOCK (PAGESIZE - OVERHEAD)
+
+static unsigned int fl_bitmap = 0;
+static unsigned int sl_bitmap[FL_COUNT] = {0};
+static block_t *blocks[FL_COUNT][SL_COUNT] = {{0}};
+static kma_page_t *tlsf_page[MAXPAGES];
+static void *tlsf_clean[MAXPAGES];
+
+
+static int fls_int(unsigned int x) {
+    return 31 - __builtin_clz(x);
+}
+
+
+static unsigned long block_size(block_t *b) {
+    return b->size & ~BLOCK_FLAGS;
+}
+
+
+static void *block_ptr(block_t *b) {
+    return (void *)b + PAYLOAD;
+}
+
+
+static block_t *block_from_ptr(void *ptr) {
+    return (block_t *)(ptr - PAYLOAD);
+}
+
+
+// the free list links point at payloads: the header of a page's first
+// block lies in front of the page, and of the pool for the first page
+static kma_link_t block_link(block_t *b) {
+    return kma_link(b ? block_ptr(b) : NULL);
+}
+
+
+static block_t *link_block(kma_link_t link) {
+    void *ptr = kma_ptr(link);
+    return ptr ? block_from_ptr(ptr) : NULL;
+}
+
+
+static kma_size_t block_is_last(block_t *b) {
+    return block_ptr(b) + block_size(b) == BASEADDR(block_ptr(b)) + PAGESIZE;
+}
+
+
+static block_t *block_next(block_t *b) {
+    return (block_t *)((void *)b + block_size(b) + OVERHEAD);
+}
+
+
+// mark free and let the next block find us through prev_phys
+// the bytes below end may have been written
+static void mark_written(void *end) {
+    int idx = page_index(end - 1);
+    if (end > tlsf_clean[idx]) {
+        tlsf_clean[idx] = end;
+    }
+}
+
+
+static void block_mark_free(block_t *b) {
+    b->size |= BLOCK_FREE;
+    if (!block_is_last(b)) {
+        block_t *next = block_next(b);
+        next->prev_phys = b;
+        next->size |= BLOCK_PREV_FREE;
+    }
+}
+
+
+static void block_mark_used(block_t *b) {
+    b->size &= ~BLOCK_FREE;
+    if (!block_is_last(b)) {
+        block_next(b)->size &= ~BLOCK_PREV_FREE;
+    }
+}
+
+
+static void mapping_insert(unsigned long size, int *fl, int *sl) {
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size >> (FL_SHIFT - SL_LG);
+    } else {
+        int f = fls_int(size);
+        *sl = (size >> (f - SL_LG)) ^ SL_COUNT;
+        *fl = f - (FL_SHIFT - 1);
+    }
+}
+
+
+// round up so that every block in the list found is big enough
+static void mapping_search(unsigned long size, int *fl, int *sl) {
+    if (size >= SMALL_BLOCK) {
+        size += (1UL << (fls_int(size) - SL_LG)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+
+static block_t *search_suitable_block(int fl, int sl) {
+    if (fl >= FL_COUNT) {
+        return NULL;
+    }
+    unsigned int sl_map = sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        unsigned int fl_map = fl_bitmap & (~0U << (fl + 1));
+        if (!fl_map) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return blocks[fl][sl];
+}
+
+
+static void insert_free_block(block_t *b) {
+    int fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    b->prev_free = block_link(NULL);
+    b->next_free = block_link(blocks[fl][sl]);
+    if (blocks[fl][sl]) {
+        blocks[fl][sl]->prev_free = block_link(b);
+    }
+    blocks[fl][sl] = b;
+    fl_bitmap |= 1U << fl;
+    sl_bitmap[fl] |= 1U << sl;
+}
+
+
+static void remove_free_block(block_t *b) {
+    int fl, sl;
+    mapping_insert(block_size(b), &fl, &sl);
+    block_t *next = link_block(b->next_free);
+    block_t *prev = link_block(b->prev_free);
+    if (next) {
+        next->prev_free = b->prev_free;
+    }
+    if (prev) {
+        prev->next_free = b->next_free;
+    } else {
+        blocks[fl][sl] = next;
+        if (!blocks[fl][sl]) {
+            sl_bitmap[fl] &= ~(1U << sl);
+            if (!sl_bitmap[fl]) {
+                fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+}
+
+
+// the whole page as one free block, not yet on a free list; NULL when
+// the pool is full, which the shim falls back from
+static block_t *new_page_block() {
+    kma_page_t *page = get_pages(1);
+    if (!page) {
+        return NULL;
+    }
+    tlsf_page[page_index(page->ptr)] = page;
+    tlsf_clean[page_index(page->ptr)] = page->zero ? page->ptr : page->ptr + PAGESIZE;
+    block_t *b = (block_t *)(page->ptr - (PAYLOAD - OVERHEAD));
+    b->size = PAGEBLOCK;
+    mark_written(block_ptr(b));
+    return b;
+}
+
+
+// hand the tail beyond size back to the free lists
+static void block_trim(block_t *b, unsigned long size) {
+    if (block_size(b) >= size + OVERHEAD + MINBLOCK) {
+        block_t *rest = (block_t *)(block_ptr(b) + size - OVERHEAD);
+        rest->size = block_size(b) - size - OVERHEAD;
+        b->size = size | (b->size & BLOCK_FLAGS);
+        block_mark_free(rest);
+        insert_free_block(rest);
+        mark_written(rest + 1);
+    }
+}
+
+
+static unsigned long adjust_size(kma_size_t size) {
+    unsigned long adjust = (size + (1 << ALIGN_LG) - 1) & ~((1UL << ALIGN_LG) - 1);
+    return adjust < MINBLOCK ? MINBLOCK : adjust;
+}
+
+
+static void *tlsf_calloc(kma_size_t size, kma_size_t *dirty) {
+    if (size <= 0 || size > PAGEBLOCK) {
+        return NULL;
+    }
+    unsigned long adjust = adjust_size(size);
+    int fl, sl;
+    mapping_search(adjust, &fl, &sl);
+    block_t *b = search_suitable_block(fl, sl);
+    if (b) {
+        remove_free_block(b);
+    } else if (!(b = new_page_block())) {
+        return NULL;
+    }
+    void *ptr = block_ptr(b);
+    void *clean = tlsf_clean[page_index(ptr)];
+    *dirty = clean <= ptr ? 0 : clean >= ptr + size ? size : clean - ptr;
+    block_trim(b, adjust);
+    block_mark_used(b);
+    mark_written(ptr + adjust);
+    return ptr;
+}
+
+static void *tlsf_malloc(kma_size_t size) {
+    kma_size_t dirty;
+    return tlsf_calloc(size, &dirty);
+}
+
+// look for room for the block, the alignment and a free block in front of
+// it; that front part goes back on the free lists
+static void *tlsf_memalign(kma_size_t align, kma_size_t size) {
+    if (align <= (1 << ALIGN_LG)) {
+        return tlsf_malloc(size);
+    }
+    if (size <= 0 || size > PAGEBLOCK) {
+        return NULL;
+    }
+    unsigned long adjust = adjust_size(size);
+    unsigned long gap = OVERHEAD + MINBLOCK;
+    block_t *b = NULL;
+    if (adjust + align + gap <= PAGEBLOCK) {
+        int fl, sl;
+        mapping_search(adjust + align + gap, &fl, &sl);
+        b = search_suitable_block(fl, sl);
+    }
+    if (b) {
+        remove_free_block(b);
+    } else if (!(b = new_page_block())) {
+        return NULL;
+    }
+    void *ptr = block_ptr(b);
+    void *start = (void *)(((long)ptr + align - 1) & ~(long)(align - 1));
+    if (start != ptr) {
+        // leave room for a free block in front
+        start = (void *)(((long)ptr + gap + align - 1) & ~(long)(align - 1));
+    }
+    if (start + adjust > ptr + block_size(b)) {
+        // only a fresh page can be too small, for a large alignment
+        free_page(tlsf_page[page_index(ptr)]);
+        return NULL;
+    }
+    if (start != ptr) {
+        block_t *a = block_from_ptr(start);
+        a->size = ptr + block_size(b) - start;
+        b->size = (start - ptr - OVERHEAD) | (b->size & BLOCK_FLAGS);
+        block_mark_free(b);
+        insert_free_block(b);
+        mark_written(start);
+        b = a;
+    }
+    block_trim(b, adjust);
+    block_mark_used(b);
+    mark_written(start + adjust);
+    return start;
+}
+
+static void tlsf_free(void *ptr, kma_size_t size) {
+    block_t *b = block_from_ptr(ptr);
+    if (b->size & BLOCK_PREV_FREE) {
+        block_t *prev = b->prev_phys;
+        remove_free_block(prev);
+        prev->size += block_size(b) + OVERHEAD;
+        b = prev;
+    }
+    if (!block_is_last(b)) {
+        block_t *next = block_next(b);
+        if (next->size & BLOCK_FREE) {
+            remove_free_block(next);
+            b->size += block_size(next) + OVERHEAD;
+        }
+    }
+    if (block_size(b) == PAGEBLOCK) {
+        free_page(tlsf_page[page_index(ptr)]);
+        return;
+    }
+    block_mark_free(b);
+    insert_free_block(b);
+}
+
+static kma_size_t tlsf_size(void *ptr) {
+    return block_size(block_from_ptr(ptr));
+}
+
+// absorb a free next block, then trim back to the size wanted, so the
+// tail handed back is coalesced with whatever followed
+static bool tlsf_resize(void *ptr, kma_size_t old_size, kma_size_t new_size) {
+    if (new_size <= 0 || new_size > PAGEBLOCK) {
+        return FALSE;
+    }
+    block_t *b = block_from_ptr(ptr);
+    unsigned long adjust = adjust_size(new_size);
+    unsigned long size = block_size(b);
+    if (!block_is_last(b)) {
+        block_t *next = block_next(b);
+        if (next->size & BLOCK_FREE) {
+            remove_free_block(next);
+            b->size += block_size(next) + OVERHEAD;
+            block_mark_used(b);
+        }
+    }
+    if (block_size(b) < adjust) {
+        block_trim(b, size);
+        return FALSE;
+    }
+    block_trim(b, adjust);
+    mark_written(ptr + adjust);
+    return TRUE;
+}
+
+kma_backend_t kma_tlsf_backend = {
+    .name = "tlsf",
+    .malloc = tlsf_malloc,
+    .free = tlsf_free,
+    .size = tlsf_size,
+    .resize = tlsf_resize,
+    .calloc = tlsf_calloc,
+    .memalign = tlsf_memalign
+};
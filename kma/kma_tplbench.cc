@@ -0,0 +1,277 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Trace replay of the C backends against their instantiations
+ *             of kma_policy.h, through the hooks and inlined
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/************Private include**********************************************/
+#include "kma_policy.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+// replays of each kind; the fastest counts
+#define REPS 5
+
+// the largest block replayed: what the size classes of all three
+// backends serve; larger ones are left out of the replay
+#define MAX_SIZE (PAGESIZE / 2)
+
+// a malloc of size into id, or with free set, the free of id
+typedef struct step_t {
+    int id;
+    int size;
+    int free;
+} step_t;
+
+/************Global Variables*********************************************/
+
+static std::vector<step_t> steps;
+
+static std::vector<void *> ptrs;
+
+/************Function Prototypes******************************************/
+extern "C" void error(char *, char *);
+
+void die(const char *message, const char *arg);
+
+double now();
+
+void load(char *file);
+
+template <class MALLOC, class FREE>
+double replay(MALLOC m, FREE f);
+
+template <class A>
+void compare(const char *c_name, const char *t_name);
+
+const char *ns(double value);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s traceFile\n", argv[0]);
+        exit(0);
+    }
+    load(argv[1]);
+
+    printf("%s: %zu steps, ns per step\n", argv[1], steps.size());
+    printf("%8s %8s %8s %8s %8s\n", "C", "ns", "template", "hooks", "inlined");
+    compare<kma::policy::tmck2>("mck2", "tmck2");
+    compare<kma::policy::tp2fl>("p2fl", "tp2fl");
+    compare<kma::policy::tbud>("bud", "tbud");
+    return 0;
+}
+
+void error(char *message, char *arg) {
+    die(message, arg);
+}
+
+void die(const char *message, const char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the trace as mallocs and frees: a REALLOC frees and mallocs, a BATCH
+// or BATCHFREE is count of them, and a DESTROY frees its arena's blocks
+void load(char *file) {
+    FILE *f = fopen(file, "r");
+    char command[16];
+    int n_req, id, size, align, count, arena, i;
+
+    if (!f || fscanf(f, "%d", &n_req) != 1) {
+        die("unable to read trace file", file);
+    }
+    std::vector<int> live(n_req / 2 + 1, 0);
+    std::vector<int> arena_of(n_req / 2 + 1, -1);
+
+    auto take = [&](int id, int size) {
+        if (size > 0 && size <= MAX_SIZE) {
+            steps.push_back({id, size, 0});
+            live[id] = size;
+        }
+    };
+    auto give = [&](int id) {
+        if (live[id]) {
+            steps.push_back({id, live[id], 1});
+            live[id] = 0;
+        }
+    };
+
+    while (fscanf(f, "%10s", command) == 1) {
+        if (!strcmp(command, "REQUEST") || !strcmp(command, "CALLOC")) {
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                die("bad line", command);
+            }
+            take(id, size);
+        } else if (!strcmp(command, "ALIGNED")) {
+            if (fscanf(f, "%d %d %d", &id, &size, &align) != 3) {
+                die("bad line", command);
+            }
+            take(id, size);
+        } else if (!strcmp(command, "ARENA")) {
+            if (fscanf(f, "%d %d %d", &arena, &id, &size) != 3) {
+                die("bad line", command);
+            }
+            take(id, size);
+            arena_of[id] = arena;
+        } else if (!strcmp(command, "DESTROY")) {
+            if (fscanf(f, "%d", &arena) != 1) {
+                die("bad line", command);
+            }
+            for (i = 0; i < (int) arena_of.size(); i++) {
+                if (arena_of[i] == arena) {
+                    give(i);
+                    arena_of[i] = -1;
+                }
+            }
+        } else if (!strcmp(command, "BATCH")) {
+            if (fscanf(f, "%d %d %d", &id, &count, &size) != 3) {
+                die("bad line", command);
+            }
+            for (i = 0; i < count; i++) {
+                take(id + i, size);
+            }
+        } else if (!strcmp(command, "BATCHFREE")) {
+            if (fscanf(f, "%d %d", &id, &count) != 2) {
+                die("bad line", command);
+            }
+            for (i = 0; i < count; i++) {
+                give(id + i);
+            }
+        } else if (!strcmp(command, "FREE")) {
+            if (fscanf(f, "%d", &id) != 1) {
+                die("bad line", command);
+            }
+            give(id);
+        } else if (!strcmp(command, "REALLOC")) {
+            if (fscanf(f, "%d %d", &id, &size) != 2) {
+                die("bad line", command);
+            }
+            give(id);
+            take(id, size);
+        } else {
+            die("unknown command", command);
+        }
+    }
+    // what the trace leaves live is freed at the end
+    for (i = 0; i < (int) live.size(); i++) {
+        give(i);
+    }
+    fclose(f);
+    ptrs.resize(live.size());
+}
+
+// ns per step of the fastest of REPS replays, or -1 if one failed;
+// each runs in a child of its own, so that every one starts with the
+// backend as it was before any of them, and a crash only ends the child
+template <class MALLOC, class FREE>
+double replay(MALLOC m, FREE f) {
+    double best = -1;
+    int r, fd[2], status;
+
+    for (r = 0; r < REPS; r++) {
+        double ns = -1;
+        if (pipe(fd) < 0) {
+            die("pipe failed", "");
+        }
+        pid_t child = fork();
+        if (child < 0) {
+            die("fork failed", "");
+        }
+        if (!child) {
+            close(fd[0]);
+            double start = now();
+            for (const step_t &s : steps) {
+                if (s.free) {
+                    f(ptrs[s.id], s.size);
+                } else if (!(ptrs[s.id] = m(s.size))) {
+                    die("a malloc failed", "");
+                }
+            }
+            ns = (now() - start) * 1e9 / steps.size();
+            if (page_stats()->num_in_use) {
+                die("not all pages freed", "");
+            }
+            if (write(fd[1], &ns, sizeof(ns)) != sizeof(ns)) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        close(fd[1]);
+        if (read(fd[0], &ns, sizeof(ns)) != sizeof(ns)) {
+            ns = -1;
+        }
+        close(fd[0]);
+        waitpid(child, &status, 0);
+        if (ns < 0) {
+            return -1;
+        }
+        if (best < 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+// the C backend through its hooks, and the instantiation A standing in
+// for it through the hooks of its backend in kma_templates.cc and
+// called directly
+template <class A>
+void compare(const char *c_name, const char *t_name) {
+    kma_backend_t *c = kma_backend_find((char *) c_name);
+    kma_backend_t *hooks = kma_backend_find((char *) t_name);
+
+    double c_ns = replay([c](kma_size_t size) { return c->malloc(size); },
+                         [c](void *ptr, kma_size_t size) { c->free(ptr, size); });
+    double hook_ns = replay([hooks](kma_size_t size) { return hooks->malloc(size); },
+                            [hooks](void *ptr, kma_size_t size) { hooks->free(ptr, size); });
+    double inline_ns = replay([](kma_size_t size) { return A::malloc(size); },
+                              [](void *ptr, kma_size_t size) { A::free(ptr, size); });
+    printf("%8s %8s %8s %8s %8s\n", c_name, ns(c_ns), t_name, ns(hook_ns), ns(inline_ns));
+    fflush(stdout);
+}
+
+// a time for the table, or "failed"
+const char *ns(double value) {
+    static char buf[4][16];
+    static int next = 0;
+    char *out = buf[next++ % 4];
+
+    if (value < 0) {
+        return "failed";
+    }
+    snprintf(out, sizeof(buf[0]), "%.1f", value);
+    return out;
+}
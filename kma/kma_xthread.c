@@ -0,0 +1,176 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Cross-thread free benchmark for the sharded allocator
+ *    Author: NetID1, NetID2, NetID3
+ *    Copyright: 2026
+ ***************************************************************************/
+
+/************************************************************************
+ Project Group: NetID1, NetID2, NetID3
+
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/************Private include**********************************************/
+#include "kma_page.h"
+#include "kma.h"
+#include "kma_shard.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#define BATCH 1024
+#define SLOTS 4
+
+typedef struct batch_t {
+    void *ptr[BATCH];
+    kma_size_t size[BATCH];
+} batch_t;
+
+/************Global Variables*********************************************/
+
+// batches handed from the producer to the consumer
+static batch_t ring[SLOTS];
+static int head = 0;
+static int tail = 0;
+static int done = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/************Function Prototypes******************************************/
+void error(char *, char *);
+
+double now();
+
+kma_size_t next_size(unsigned int *);
+
+void fill(batch_t *, unsigned int *);
+
+void *consumer(void *);
+
+/************External Declaration*****************************************/
+
+/**************Implementation***********************************************/
+
+int main(int argc, char *argv[]) {
+    int batches = argc > 1 ? atoi(argv[1]) : 2000;
+    unsigned int seed = 343;
+    batch_t local;
+    int i, j;
+
+    if (batches <= 0) {
+        printf("Usage: %s [batches]\n", argv[0]);
+        exit(0);
+    }
+
+    // keep the pool mapped; the page layer drops it when no page is in use
+    void *pin = kma_malloc(16);
+
+    // same thread: allocate a batch, free it
+    double start = now();
+    for (i = 0; i < batches; i++) {
+        fill(&local, &seed);
+        for (j = 0; j < BATCH; j++) {
+            kma_free(local.ptr[j], local.size[j]);
+        }
+    }
+    double local_time = now() - start;
+    kma_shard_collect();
+
+    // producer allocates, consumer frees into the producer's pages
+    pthread_t thread;
+    pthread_create(&thread, NULL, consumer, NULL);
+    start = now();
+    for (i = 0; i < batches; i++) {
+        pthread_mutex_lock(&lock);
+        while (head - tail == SLOTS) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+        fill(&ring[head % SLOTS], &seed);
+        pthread_mutex_lock(&lock);
+        head++;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+    pthread_mutex_lock(&lock);
+    done = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    double remote_time = now() - start;
+    kma_free(pin, 16);
+    kma_shard_collect();
+
+    kma_page_stat_t *stat = page_stats();
+    double ops = 2.0 * batches * BATCH;
+    printf("same-thread free:  %8.2f Mops/s\n", ops / local_time / 1e6);
+    printf("cross-thread free: %8.2f Mops/s\n", ops / remote_time / 1e6);
+    printf("Page Requested/Freed/In Use: %5d/%5d/%5d\n", stat->num_requested, stat->num_freed, stat->num_in_use);
+    return stat->num_in_use != 0;
+}
+
+void error(char *message, char *arg) {
+    fprintf(stderr, "ERROR: %s: %s.\n", message, arg);
+    exit(-1);
+}
+
+double now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// log-distributed sizes between 8 and 4096, like the traces
+kma_size_t next_size(unsigned int *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return 8 << ((*seed >> 16) % 10);
+}
+
+void fill(batch_t *batch, unsigned int *seed) {
+    int j;
+
+    for (j = 0; j < BATCH; j++) {
+        batch->size[j] = next_size(seed) - (*seed >> 8) % 8;
+        batch->ptr[j] = kma_malloc(batch->size[j]);
+        assert(batch->ptr[j] != NULL);
+    }
+}
+
+void *consumer(void *arg) {
+    int j;
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (head == tail && !done) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        if (head == tail) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        pthread_mutex_unlock(&lock);
+        batch_t *batch = &ring[tail % SLOTS];
+        for (j = 0; j < BATCH; j++) {
+            kma_free(batch->ptr[j], batch->size[j]);
+        }
+        pthread_mutex_lock(&lock);
+        tail++;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+    kma_shard_collect();
+    return NULL;
+}